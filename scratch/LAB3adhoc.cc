@@ -26,9 +26,27 @@
 #include "ns3/internet-module.h"
 #include "ns3/propagation-delay-model.h"
 #include "ns3/olsr-module.h"
+#include <cmath>
+#include <functional>
 #include <iostream>
+#include <set>
+#include <utility>
+#include <vector>
 #include "ns3/constant-rate-wifi-manager.h"
 #include "ns3/ipv4-address-helper.h"
+#include "arp-prefill.h"
+#include "async-pcap.h"
+#include "cached-propagation.h"
+#include "convergence-monitor.h"
+#include "counting-sink.h"
+#include "flow-stats.h"
+#include "profiling-scheduler.h"
+#include "route-gate.h"
+#include "run-record.h"
+#include "saturating-source.h"
+#include "spatial-wifi-channel.h"
+#include "static-mesh-routing.h"
+#include "trace-fingerprint.h"
 
 
            
@@ -42,26 +60,86 @@ NS_LOG_COMPONENT_DEFINE ("LAB3");
 
 int main (int argc, char *argv[])
 {
+  WallTimer wall;
   bool verbose = true;
   uint32_t nWifi = 6;
   std::string phyMode("DsssRate1Mbps");
   double nodeDistance = 200;
+  std::string layout = "line";
+  uint32_t nFlows = 1;
   uint32_t packetSize = 300;
+  bool pcap = true;
+  PcapOptions pcapOptions;
+  std::string pcapPrefix = "";
+  std::string output = "";
+  bool spatialChannel = false;
+  bool propagationCache = false;
+  bool saturate = false;
+  double converge = 0;
+  double convergeInterval = 0.5;
+  std::string profile;
+  bool fingerprint = false;
+  std::string fingerprintWindows;
+  std::string routing = "olsr";
+  std::string transport = "udp";
+  bool staticArp = false;
 
   CommandLine cmd;
   cmd.AddValue ("nWifi", "Number of wifi STA devices", nWifi);
   cmd.AddValue ("packetSize", "size of application packet sent", packetSize);
+  cmd.AddValue ("distance", "Distance between neighbouring nodes [m]", nodeDistance);
+  cmd.AddValue ("layout", "Node placement: line, grid or disc (uniform, one node per distance^2)", layout);
+  cmd.AddValue ("routing", "olsr, or static for minimum-hop routes computed from the positions at setup", routing);
+  cmd.AddValue ("transport", "udp, or tcp (OnOff, or BulkSend with --saturate, segments of packetSize; under OLSR started once the flows are routed)", transport);
+  cmd.AddValue ("staticArp", "Fill all ARP caches at setup instead of resolving on demand; always on with tcp", staticArp);
+  cmd.AddValue ("nFlows", "Concurrent flows; the first is node 0 -> nWifi-1, the rest random pairs", nFlows);
   cmd.AddValue ("verbose", "Tell echo applications to log if true", verbose);
+  cmd.AddValue ("pcap", "Write pcap traces for all nodes", pcap);
+  pcapOptions.AddValues (cmd);
+  cmd.AddValue ("pcapPrefix", "Pcap file prefix, results/nSta-<nWifi>-pktSize-<packetSize>-node if empty", pcapPrefix);
+  cmd.AddValue ("output", "File the run record is appended to, stdout if empty", output);
+  cmd.AddValue ("spatialChannel", "Only deliver frames to PHYs within detection range", spatialChannel);
+  cmd.AddValue ("propagationCache", "Memoize loss and delay per node pair", propagationCache);
+  cmd.AddValue ("saturate", "Only generate packets when the source's MAC queue has room instead of offering 10 Mbps", saturate);
+  cmd.AddValue ("converge", "Stop early once the 95% CI of the goodput is within this fraction of its mean, 0 = always simulate 100 s", converge);
+  cmd.AddValue ("convergeInterval", "Goodput sampling interval [s]", convergeInterval);
+  cmd.AddValue ("fingerprint", "Add a hash of all PHY, MAC drop and receive events to the record", fingerprint);
+  cmd.AddValue ("fingerprintWindows", "Also write one hash per simulated second to this file", fingerprintWindows);
+  cmd.AddValue ("profile", "Write wall time per event type and per simulated second to this file (\"-\" = stdout)", profile);
   cmd.Parse (argc,argv);
 
+  if (!profile.empty ())
+    {
+      ProfilingScheduler::Enable (profile);
+    }
+
   std::ostringstream out;
   out << "results/" << "nSta-" << nWifi << "-pktSize-" << packetSize << "-node";
-  std::string pcapName(out.str());
+  std::string pcapName(pcapPrefix.empty () ? out.str () : pcapPrefix);
 
-  if (nWifi > 18)
+  if (nWifi < 2 || nWifi > 65534)
+    {
+      std::cout << "Need between 2 and 65534 wifi nodes, got " << nWifi << std::endl;
+      exit (1);
+    }
+  if (layout != "line" && layout != "grid" && layout != "disc")
+    {
+      std::cout << "Unknown layout " << layout << std::endl;
+      exit (1);
+    }
+  if (routing != "olsr" && routing != "static")
+    {
+      std::cout << "Unknown routing " << routing << std::endl;
+      exit (1);
+    }
+  if (transport != "udp" && transport != "tcp")
     {
-      std::cout << "Number of wifi nodes " << nWifi << 
-                   " specified exceeds the mobility bounding box" << std::endl;
+      std::cout << "Unknown transport " << transport << std::endl;
+      exit (1);
+    }
+  if (nFlows < 1 || nFlows > uint64_t (nWifi) * (nWifi - 1) || nFlows > 64535)
+    {
+      std::cout << "Cannot place " << nFlows << " flows on " << nWifi << " nodes" << std::endl;
       exit (1);
     }
 
@@ -84,8 +162,20 @@ int main (int argc, char *argv[])
   Ptr<YansWifiChannel> wifiChannel = CreateObject <YansWifiChannel>(); // pointer to wifichannel object
   Ptr<TwoRayGroundPropagationLossModel> lossModel = CreateObject<TwoRayGroundPropagationLossModel> (); // 
   Ptr<ConstantSpeedPropagationDelayModel> delayModel = CreateObject <ConstantSpeedPropagationDelayModel>();
-  wifiChannel->SetPropagationLossModel(lossModel);
-  wifiChannel->SetPropagationDelayModel(delayModel);
+  // The chain is static, so the cached models compute every link once.
+  Ptr<PropagationLossModel> channelLoss = lossModel;
+  Ptr<PropagationDelayModel> channelDelay = delayModel;
+  if (propagationCache)
+    {
+      Ptr<CachedPropagationLossModel> cachedLoss = CreateObject<CachedPropagationLossModel> ();
+      cachedLoss->SetModel (lossModel);
+      channelLoss = cachedLoss;
+      Ptr<CachedPropagationDelayModel> cachedDelay = CreateObject<CachedPropagationDelayModel> ();
+      cachedDelay->SetModel (delayModel);
+      channelDelay = cachedDelay;
+    }
+  wifiChannel->SetPropagationLossModel(channelLoss);
+  wifiChannel->SetPropagationDelayModel(channelDelay);
 
 
   //Physical layer of WiFi
@@ -134,24 +224,55 @@ int main (int argc, char *argv[])
   // lab specs specifies 200m distance between nodes, contradictory to this comment that says 400. 
   // loop places nodes with a distance of set distance in beginning constant declarations of main.
   
+  // "line" is the original chain; "grid" fills rows of ceil(sqrt(nWifi))
+  // nodes; "disc" scatters the nodes uniformly over a disc sized for the same
+  // density as the grid. All of them are O(nWifi).
   MobilityHelper mobility;
-  Ptr<ListPositionAllocator> positionAlloc = CreateObject<ListPositionAllocator>();
-  for (uint32_t n = 0; n < nWifi; n++) {
-	  positionAlloc->Add(Vector((n * nodeDistance), 0.0, 1.0));
-  }
+  if (layout == "disc")
+    {
+      Ptr<UniformDiscPositionAllocator> discAlloc = CreateObject<UniformDiscPositionAllocator> ();
+      discAlloc->SetRho (nodeDistance * std::sqrt (nWifi / M_PI));
+      discAlloc->SetZ (1.0);
+      mobility.SetPositionAllocator (discAlloc);
+    }
+  else
+    {
+      uint32_t columns = layout == "grid" ? uint32_t (std::ceil (std::sqrt (double (nWifi)))) : nWifi;
+      Ptr<ListPositionAllocator> positionAlloc = CreateObject<ListPositionAllocator>();
+      for (uint32_t n = 0; n < nWifi; n++) {
+	      positionAlloc->Add(Vector((n % columns) * nodeDistance, (n / columns) * nodeDistance, 1.0));
+      }
+      mobility.SetPositionAllocator(positionAlloc);
+    }
 
-  mobility.SetPositionAllocator(positionAlloc);
   mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
   mobility.Install(staNodes);
+
+  // Split the shared channel into per-transmitter neighbour lists once the
+  // positions are known; see spatial-wifi-channel.h.
+  if (spatialChannel)
+    {
+      SpatialWifiChannelHelper spatial (channelLoss, channelDelay);
+      spatial.Install (devices);
+    }
 /////////////////////////////Stack of protocols///////////////////////////// 
 
   
 //  Enable OLSR routing
    OlsrHelper olsr;
+  // or only static routes, filled in once the addresses are assigned
+  Ipv4StaticRoutingHelper staticRouting;
 
  //  Install the routing protocol
    Ipv4ListRoutingHelper list;
-   list.Add (olsr, 10);
+  if (routing == "static")
+    {
+      list.Add (staticRouting, 0);
+    }
+  else
+    {
+      list.Add (olsr, 10);
+    }
 
   // Set up internet stack
 
@@ -165,78 +286,164 @@ int main (int argc, char *argv[])
  //TODO
  //Create Ipv4InterfaceContainer 
  // assign IP addresses to WifiDevices into Ipv4InterfaceContainer
-  address.SetBase ("10.1.1.0", "255.255.255.0");
+  // A /16 so that chains of thousands of nodes still fit into one subnet.
+  address.SetBase ("10.1.0.0", "255.255.0.0");
   Ipv4InterfaceContainer wifiInterfaces;
   wifiInterfaces = address.Assign(devices);
 
+  // Neighbours are resolved before the first packet, so no SYN is lost to
+  // ARP (no echo warm-up needed).
+  ArpPrefillHelper arpPrefill;
+  if (staticArp || transport == "tcp")
+    {
+      arpPrefill.Install (staNodes);
+    }
+
 /////////////////////////////Application part///////////////////////////// 
  
    uint16_t dlPort = 1000; //Port number
+    std::string socketFactory = transport == "tcp" ? "ns3::TcpSocketFactory" : "ns3::UdpSocketFactory";
+    if (transport == "tcp")
+      {
+        // packetSize keeps meaning the payload per frame
+        Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (packetSize));
+      }
+    // OLSR has no routes at t=0 and a TCP connect without one leaves the
+    // socket closed for good, so under OLSR the TCP sources are only
+    // installed, and so only start, once every flow is routed both ways.
+    // Static routes exist from the start.
+    bool waitForRoutes = transport == "tcp" && routing == "olsr";
     
-    //Sending application on the first station
-    
-    ApplicationContainer onOffApp;
-    OnOffHelper onOffHelper("ns3::UdpSocketFactory", InetSocketAddress(wifiInterfaces.GetAddress (nWifi-1), dlPort)); //OnOffApplication, UDP traffic,
-    onOffHelper.SetAttribute("OnTime", StringValue ("ns3::ConstantRandomVariable[Constant=5000]"));
-    onOffHelper.SetAttribute("OffTime", StringValue ("ns3::ConstantRandomVariable[Constant=0]"));
-    onOffHelper.SetAttribute("DataRate", DataRateValue(DataRate("10.0Mbps"))); //Traffic Bit Rate
-    onOffHelper.SetAttribute("PacketSize", UintegerValue(packetSize)); // Packet size
-    onOffApp.Add(onOffHelper.Install(staNodes.Get(0)));  
- 
-    
-  //Opening receiver socket on the last station
-  TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
-  Ptr<Socket> recvSink = Socket::CreateSocket (staNodes.Get (nWifi-1), tid);
-  InetSocketAddress local = InetSocketAddress (wifiInterfaces.GetAddress (nWifi-1), dlPort);
-  bool ipRecvTos = true;
-  recvSink->SetIpRecvTos (ipRecvTos);
-  bool ipRecvTtl = true;
-  recvSink->SetIpRecvTtl (ipRecvTtl);
-  recvSink->Bind (local);
-
-
-///////////////USE WHEN WORKING WITH TCP TO FILL IN ARP TABLES//////////////////////
-/*
-  UdpEchoServerHelper echoServer (9);
+    // Flow 0 is the original node 0 -> node nWifi-1 flow; further flows run
+    // between random distinct node pairs, each to its own port.
+    std::vector<std::pair<uint32_t, uint32_t> > flows;
+    flows.push_back (std::make_pair (0, nWifi - 1));
+    std::set<std::pair<uint32_t, uint32_t> > used (flows.begin (), flows.end ());
+    Ptr<UniformRandomVariable> pick = CreateObject<UniformRandomVariable> ();
+    while (flows.size () < nFlows)
+      {
+        uint32_t src = pick->GetInteger (0, nWifi - 1);
+        uint32_t dst = pick->GetInteger (0, nWifi - 1);
+        if (src != dst && used.insert (std::make_pair (src, dst)).second)
+          {
+            flows.push_back (std::make_pair (src, dst));
+          }
+      }
 
-  ApplicationContainer serverApps = echoServer.Install (wifiStaNodes.Get (nWifi-1));
-  serverApps.Start (Seconds (2.0));
-  serverApps.Stop (Seconds (6.0));
-
-  UdpEchoClientHelper echoClient (wifiInterfaces.GetAddress (nWifi-1), 9);
-  echoClient.SetAttribute ("MaxPackets", UintegerValue (100));
-  echoClient.SetAttribute ("Interval", TimeValue (Seconds (1.0)));
-  echoClient.SetAttribute ("PacketSize", UintegerValue (100));
-
-  ApplicationContainer clientApps = echoClient.Install (wifiStaNodes.Get (0));
-  clientApps.Start (Seconds (2.0));
-  clientApps.Stop (Seconds (6.0));
-*/
-/////////////////////////////////////////////////////////////////////////////////
+    ApplicationContainer onOffApp;
+    std::function<void ()> installSources = [&] ()
+    {
+      for (uint32_t f = 0; f < flows.size (); f++)
+        {
+          uint32_t src = flows[f].first, dst = flows[f].second;
+
+          //Sending application on the source station
+          if (saturate && transport == "tcp")
+            {
+              // TCP's own window keeps the queue full
+              BulkSendHelper bulk ("ns3::TcpSocketFactory", InetSocketAddress (wifiInterfaces.GetAddress (dst), dlPort + f));
+              bulk.SetAttribute ("SendSize", UintegerValue (packetSize));
+              onOffApp.Add (bulk.Install (staNodes.Get (src)));
+            }
+          else if (saturate)
+            {
+              // Always on, one packet per free slot in the source's MAC queue.
+              SaturatingSourceHelper source ("ns3::UdpSocketFactory", InetSocketAddress (wifiInterfaces.GetAddress (dst), dlPort + f));
+              source.SetAttribute ("OnTime", StringValue ("ns3::ConstantRandomVariable[Constant=5000]"));
+              source.SetAttribute ("PacketSize", UintegerValue (packetSize));
+              onOffApp.Add (source.Install (staNodes.Get (src)));
+            }
+          else
+            {
+              OnOffHelper onOffHelper(socketFactory, InetSocketAddress(wifiInterfaces.GetAddress (dst), dlPort + f)); //OnOffApplication, UDP or TCP traffic,
+              onOffHelper.SetAttribute("OnTime", StringValue ("ns3::ConstantRandomVariable[Constant=5000]"));
+              onOffHelper.SetAttribute("OffTime", StringValue ("ns3::ConstantRandomVariable[Constant=0]"));
+              onOffHelper.SetAttribute("DataRate", DataRateValue(DataRate("10.0Mbps"))); //Traffic Bit Rate
+              onOffHelper.SetAttribute("PacketSize", UintegerValue(packetSize)); // Packet size
+              onOffApp.Add(onOffHelper.Install(staNodes.Get(src)));
+            }
+        }
+    };
+
+    ApplicationContainer sinkApps;
+    for (uint32_t f = 0; f < flows.size (); f++)
+      {
+        uint32_t dst = flows[f].second;
+
+        //Counting sink on the sink station, drains every packet on arrival
+        CountingSinkHelper sinkHelper (socketFactory, InetSocketAddress (wifiInterfaces.GetAddress (dst), dlPort + f));
+        sinkApps.Add (sinkHelper.Install (staNodes.Get (dst)));
+      }
+
+    RouteGate routeGate;
+    if (waitForRoutes)
+      {
+        for (uint32_t f = 0; f < flows.size (); f++)
+          {
+            routeGate.Watch (staNodes.Get (flows[f].first), wifiInterfaces.GetAddress (flows[f].first),
+                             staNodes.Get (flows[f].second), wifiInterfaces.GetAddress (flows[f].second));
+          }
+        routeGate.OnReady (installSources);
+      }
+    else
+      {
+        installSources ();
+      }
+
+    // Routes towards both ends of every flow, so replies find their way
+    // back too; without OLSR there are no control packets at all.
+    StaticMeshRoutingHelper staticMesh (channelLoss);
+    if (routing == "static")
+      {
+        NodeContainer endpoints;
+        for (uint32_t f = 0; f < flows.size (); f++)
+          {
+            endpoints.Add (staNodes.Get (flows[f].first));
+            endpoints.Add (staNodes.Get (flows[f].second));
+          }
+        staticMesh.Install (devices, endpoints);
+      }
+
+
+/////////////////////////////Throughput accounting/////////////////////////////
+  // Per-flow goodput/loss and the MAC throughput seen at the receiver, so the
+  // numbers no longer have to be read out of the pcaps.
+  FlowStats flowStats;
+  flowStats.Install (staNodes);
+  for (uint32_t f = 0; f < flows.size (); f++)
+    {
+      flowStats.Track ("app", wifiInterfaces.GetAddress (flows[f].second), dlPort + f);
+    }
+  flowStats.MonitorMac (staNodes.Get (nWifi-1));
 
-/////////////////////TCP app///////////////////////////
-/*
-  uint16_t port = 50000;
-  Address sinkLocalAddress (InetSocketAddress (Ipv4Address::GetAny (), port));
-  PacketSinkHelper sinkHelper ("ns3::TcpSocketFactory", sinkLocalAddress);
-  ApplicationContainer sinkApp = sinkHelper.Install (wifiStaNodes.Get (nWifi-1));
-  sinkApp.Start (Seconds (10.0));
-  sinkApp.Stop (Seconds (100.0));
-  // Create the OnOff applications to send TCP to the server (client part)
-  OnOffHelper clientHelper ("ns3::TcpSocketFactory", Address ());
-  clientHelper.SetAttribute ("OnTime", StringValue ("ns3::ConstantRandomVariable[Constant=1]"));
-  clientHelper.SetAttribute("DataRate", DataRateValue(DataRate("10.0Mbps"))); //Traffic Bit Rate
-  clientHelper.SetAttribute ("OffTime", StringValue ("ns3::ConstantRandomVariable[Constant=0]"));
-  ApplicationContainer clientApp;
-      AddressValue clientAddress(InetSocketAddress (wifiInterfaces.GetAddress (nWifi-1), port));
-      clientHelper.SetAttribute ("Remote", clientAddress);
-      clientApp=clientHelper.Install (wifiStaNodes.Get (0));
-      clientApp.Start (Seconds (10.0));
-      clientApp.Stop (Seconds (100.0));
-*/
-
-////////////////////////////////////////////////////////////
+  // Multi-hop chains settle long before 100 s; stop once the goodput does
+  ConvergenceMonitor monitor (MakeBoundCallback (&CountingSink::GetRxBytes, sinkApps),
+                              Seconds (convergeInterval), converge);
+  if (waitForRoutes)
+    {
+      // Measure from when the sources start
+      routeGate.OnReady ([&] ()
+      {
+        flowStats.SetStart (Simulator::Now ());
+        if (converge > 0)
+          {
+            monitor.Start ();
+          }
+      });
+      routeGate.Start ();
+    }
+  else if (converge > 0)
+    {
+      monitor.Start ();
+    }
 
+  // Compare against a run without --spatialChannel/--propagationCache/...
+  TraceFingerprint traceFingerprint;
+  if (fingerprint || !fingerprintWindows.empty ())
+    {
+      traceFingerprint.ConnectWifi ();
+      traceFingerprint.ConnectApps (sinkApps);
+    }
 
 /////////////////////////////Application part///////////////////////////// 
   Simulator::Stop (Seconds (100.0));
@@ -244,9 +451,60 @@ int main (int argc, char *argv[])
 /////////////////////////////PCAP tracing/////////////////////////////   
    //TODO 
    //Enable PCAP tracing for all devices
-  phy.EnablePcap(pcapName, staNodes, true);
+  AsyncPcapHelper asyncPcap (pcapOptions);
+  if (pcap && pcapOptions.async)
+    {
+      asyncPcap.EnableWifi (pcapName, staNodes);
+    }
+  else if (pcap)
+    {
+      phy.EnablePcap(pcapName, staNodes, true);
+    }
 
+  double setupSeconds = wall.Seconds ();
+  WallTimer sim;
   Simulator::Run ();
+  asyncPcap.Close ();
+
+  RunRecord record;
+  record.Add ("nWifi", nWifi);
+  record.Add ("packetSize", packetSize);
+  record.Add ("layout", layout);
+  record.Add ("nFlows", nFlows);
+  record.Add ("routing", routing);
+  record.Add ("transport", transport);
+  record.Add ("arp_entries", arpPrefill.GetEntryCount ());
+  if (waitForRoutes)
+    {
+      routeGate.Record (record);
+    }
+  if (routing == "static")
+    {
+      record.Add ("links", staticMesh.GetLinkCount ());
+      record.Add ("routes", staticMesh.GetRouteCount ());
+      record.Add ("unreachable", staticMesh.GetUnreachableCount ());
+    }
+  record.Add ("setup_s", setupSeconds);
+  record.Add ("sim_s", sim.Seconds ());
+  record.Add ("events", Simulator::GetEventCount ());
+  flowStats.Record (record);
+  CountingSink::Record (sinkApps, "app", record);
+  if (converge > 0)
+    {
+      monitor.Record (record);
+    }
+  if (fingerprint || !fingerprintWindows.empty ())
+    {
+      traceFingerprint.Record (record);
+    }
+  if (!fingerprintWindows.empty ())
+    {
+      traceFingerprint.WriteWindows (fingerprintWindows);
+    }
+  record.Add ("wall_s", wall.Seconds ());
+  record.Add ("rss_kb", PeakRssKb ());
+  record.Write (output);
+
   Simulator::Destroy ();
 return 0;
 };
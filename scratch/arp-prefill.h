@@ -0,0 +1,110 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ARP_PREFILL_H
+#define ARP_PREFILL_H
+
+#include "ns3/arp-cache.h"
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * Fills the ARP caches of a set of nodes with permanent entries, so that the
+ * first packet to a neighbour goes out right away instead of waiting for an
+ * ARP request/reply exchange (which on a busy or multi-hop Wi-Fi channel can
+ * take seconds, or fail and drop the packet, and used to be worked around
+ * with echo traffic and late application starts).
+ *
+ * Every IPv4 address on an ARP-using device becomes an entry in the cache of
+ * every other interface of the same subnet. Subnets rather than channels
+ * decide who is a neighbour, since SpatialWifiChannelHelper gives every
+ * transmitter a channel of its own. That is O(N^2) entries for N interfaces
+ * in one subnet. Call after the addresses are assigned; addresses assigned
+ * later are not known.
+ */
+class ArpPrefillHelper {
+public:
+  ArpPrefillHelper() : m_entries(0) {}
+
+  void Install(NodeContainer nodes) {
+    typedef std::pair<uint32_t, uint32_t> Subnet; // Network, mask
+    std::map<Subnet, std::vector<Peer>> subnets;
+    for (NodeContainer::Iterator n = nodes.Begin(); n != nodes.End(); n++) {
+      Ptr<Ipv4L3Protocol> ipv4 = (*n)->GetObject<Ipv4L3Protocol>();
+      if (ipv4 == 0) {
+        continue;
+      }
+      for (uint32_t i = 0; i < ipv4->GetNInterfaces(); i++) {
+        Ptr<Ipv4Interface> iface = ipv4->GetInterface(i);
+        Ptr<NetDevice> dev = iface->GetDevice();
+        if (!dev->NeedsArp() || iface->GetArpCache() == 0) {
+          continue;
+        }
+        for (uint32_t a = 0; a < iface->GetNAddresses(); a++) {
+          Ipv4InterfaceAddress address = iface->GetAddress(a);
+          Ipv4Mask mask = address.GetMask();
+          Subnet subnet(address.GetLocal().CombineMask(mask).Get(),
+                        mask.Get());
+          Peer peer = {iface, address.GetLocal(), dev->GetAddress()};
+          subnets[subnet].push_back(peer);
+        }
+      }
+    }
+
+    for (std::map<Subnet, std::vector<Peer>>::const_iterator s =
+             subnets.begin();
+         s != subnets.end(); s++) {
+      const std::vector<Peer> &peers = s->second;
+      for (size_t i = 0; i < peers.size(); i++) {
+        Ptr<ArpCache> cache = peers[i].iface->GetArpCache();
+        for (size_t j = 0; j < peers.size(); j++) {
+          if (peers[j].iface == peers[i].iface) {
+            continue;
+          }
+          ArpCache::Entry *entry = cache->Lookup(peers[j].ip);
+          if (entry == 0) {
+            entry = cache->Add(peers[j].ip);
+          }
+          entry->SetMacAddress(peers[j].mac);
+          entry->MarkPermanent();
+          m_entries++;
+        }
+      }
+    }
+  }
+
+  /* Entries written by Install() so far. */
+  uint64_t GetEntryCount() const { return m_entries; }
+
+private:
+  struct Peer {
+    Ptr<Ipv4Interface> iface;
+    Ipv4Address ip;
+    Address mac;
+  };
+
+  uint64_t m_entries;
+};
+
+} // namespace ns3
+
+#endif /* ARP_PREFILL_H */
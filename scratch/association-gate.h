@@ -0,0 +1,110 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ASSOCIATION_GATE_H
+#define ASSOCIATION_GATE_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/wifi-module.h"
+#include "run-record.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * Holds back traffic and measurements until every STA of an infrastructure
+ * BSS is associated, so that nothing measured includes the scanning and
+ * association transient.
+ *
+ * StaWifiMac keeps its association state private, so STAs cannot be created
+ * associated. With StaWifiMac::ActiveProbing and without
+ * ApWifiMac::EnableBeaconJitter association is short and deterministic
+ * instead (a probe request at start-up rather than waiting for a beacon),
+ * and the gate runs the OnReady() actions from the moment the last STA
+ * fires its "Assoc" trace, typically one ProbeRequestTimeout (50 ms) into
+ * the run. The AP learns the STAs from their association requests, and
+ * ConstantRateWifiManager has no per-station state to warm up.
+ */
+class AssociationGate {
+public:
+  AssociationGate() : m_pending(0), m_ready(Seconds(-1)) {}
+
+  /* Wait for every StaWifiMac in `devices`. */
+  void Watch(NetDeviceContainer devices) {
+    for (NetDeviceContainer::Iterator i = devices.Begin(); i != devices.End();
+         i++) {
+      Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>(*i);
+      Ptr<StaWifiMac> mac =
+          dev ? DynamicCast<StaWifiMac>(dev->GetMac()) : Ptr<StaWifiMac>();
+      if (mac == 0) {
+        continue;
+      }
+      mac->TraceConnect("Assoc", std::to_string(m_associated.size()),
+                        MakeCallback(&AssociationGate::Associated, this));
+      m_associated.push_back(false);
+      m_pending++;
+    }
+  }
+
+  /* Run `action` once all watched STAs are associated. */
+  void OnReady(const std::function<void()> &action) {
+    m_actions.push_back(action);
+  }
+
+  /* Start waiting; with nothing to wait for the actions run right away. */
+  void Start() {
+    if (m_pending == 0) {
+      Simulator::ScheduleNow(&AssociationGate::Open, this);
+    }
+  }
+
+  /* "assoc_s": when the last STA associated, -1 if some never did. */
+  void Record(RunRecord &record) const {
+    record.Add("assoc_s", m_ready.IsNegative() ? -1.0 : m_ready.GetSeconds());
+  }
+
+private:
+  void Associated(std::string context, Mac48Address bssid) {
+    size_t sta = std::stoul(context);
+    if (m_associated[sta]) {
+      return;
+    }
+    m_associated[sta] = true;
+    if (--m_pending == 0) {
+      // Not from inside the MAC's receive path
+      Simulator::ScheduleNow(&AssociationGate::Open, this);
+    }
+  }
+
+  void Open() {
+    m_ready = Simulator::Now();
+    for (size_t i = 0; i < m_actions.size(); i++) {
+      m_actions[i]();
+    }
+  }
+
+  std::vector<bool> m_associated;
+  uint32_t m_pending;
+  Time m_ready;
+  std::vector<std::function<void()>> m_actions;
+};
+
+} // namespace ns3
+
+#endif /* ASSOCIATION_GATE_H */
@@ -0,0 +1,269 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ASYNC_PCAP_H
+#define ASYNC_PCAP_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/wifi-module.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace ns3 {
+
+/* Capture settings shared by every file of one AsyncPcapHelper. */
+struct PcapOptions {
+  bool async = false;      // Use AsyncPcapHelper instead of the ns-3 helpers
+  uint32_t snapLen = 65535; // Bytes kept per frame
+  double start = 0;        // Capture window [s]
+  double stop = 0;         // End of the capture window [s], 0 = no end
+  uint32_t sample = 1;     // Keep one frame in `sample`
+  uint32_t blockKb = 1024; // Size of each of the two buffers per file
+
+  void AddValues(CommandLine &cmd) {
+    cmd.AddValue("pcapAsync", "Write pcaps from a background thread", async);
+    cmd.AddValue("pcapSnapLen", "Bytes captured per frame (async only)",
+                 snapLen);
+    cmd.AddValue("pcapStart", "Start of the capture window [s] (async only)",
+                 start);
+    cmd.AddValue("pcapStop", "End of the capture window [s], 0 = end of run "
+                             "(async only)",
+                 stop);
+    cmd.AddValue("pcapSample", "Capture one frame in N (async only)", sample);
+    cmd.AddValue("pcapBlockKb", "Write buffer per file and half [kB] (async "
+                                "only)",
+                 blockKb);
+  }
+};
+
+/*
+ * Drop-in replacement for YansWifiPhyHelper::EnablePcap and
+ * PointToPointHelper::EnablePcapAll. Frames are filtered (time window, 1-in-N
+ * sampling), truncated to the snap length and appended to an in-memory block
+ * on the simulation thread. Full blocks are handed to a single background
+ * thread that writes them out while the simulation fills the file's second
+ * block, so the simulator only blocks if the disk falls behind by a whole
+ * block.
+ *
+ * File names and link types match the ns-3 helpers ("<prefix>-<node>-<dev>",
+ * DLT_IEEE802_11 for Wi-Fi, DLT_PPP for point-to-point). Captures are
+ * complete once the helper is destroyed or Close() is called.
+ */
+class AsyncPcapHelper {
+public:
+  explicit AsyncPcapHelper(const PcapOptions &options)
+      : m_options(options), m_stop(false) {
+    if (m_options.sample == 0) {
+      m_options.sample = 1;
+    }
+  }
+
+  ~AsyncPcapHelper() { Close(); }
+
+  /* Capture every frame the Wi-Fi PHYs of `nodes` send or receive. */
+  void EnableWifi(const std::string &prefix, NodeContainer nodes) {
+    for (NodeContainer::Iterator n = nodes.Begin(); n != nodes.End(); n++) {
+      for (uint32_t d = 0; d < (*n)->GetNDevices(); d++) {
+        Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>((*n)->GetDevice(d));
+        if (dev == 0) {
+          continue;
+        }
+        File *file = Open(prefix, dev, 105);
+        Ptr<WifiPhy> phy = dev->GetPhy();
+        phy->TraceConnectWithoutContext(
+            "PhyTxBegin", MakeCallback(&AsyncPcapHelper::File::Capture, file));
+        phy->TraceConnectWithoutContext(
+            "PhyRxEnd", MakeCallback(&AsyncPcapHelper::File::Capture, file));
+      }
+    }
+  }
+
+  /* Capture all point-to-point devices in the simulation. */
+  void EnablePointToPointAll(const std::string &prefix) {
+    for (NodeList::Iterator n = NodeList::Begin(); n != NodeList::End(); n++) {
+      for (uint32_t d = 0; d < (*n)->GetNDevices(); d++) {
+        Ptr<PointToPointNetDevice> dev =
+            DynamicCast<PointToPointNetDevice>((*n)->GetDevice(d));
+        if (dev == 0) {
+          continue;
+        }
+        File *file = Open(prefix, dev, 9);
+        dev->TraceConnectWithoutContext(
+            "PromiscSniffer",
+            MakeCallback(&AsyncPcapHelper::File::Capture, file));
+      }
+    }
+  }
+
+  /* Flush every file and stop the writer thread. Later frames are ignored. */
+  void Close() {
+    if (!m_writer.joinable()) {
+      return;
+    }
+    for (size_t i = 0; i < m_files.size(); i++) {
+      Submit(m_files[i].get());
+    }
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_cv.notify_all();
+    m_writer.join();
+    for (size_t i = 0; i < m_files.size(); i++) {
+      m_files[i]->closed = true;
+      close(m_files[i]->fd);
+    }
+  }
+
+private:
+  struct File {
+    AsyncPcapHelper *owner;
+    int fd;
+    bool closed;
+    bool busy; // `flushing` is queued or being written; guarded by m_mutex
+    uint64_t seen;
+    std::vector<uint8_t> active;
+    std::vector<uint8_t> flushing;
+
+    void Capture(Ptr<const Packet> packet) {
+      const PcapOptions &o = owner->m_options;
+      Time now = Simulator::Now();
+      if (closed || now < Seconds(o.start) ||
+          (o.stop > 0 && now > Seconds(o.stop)) || seen++ % o.sample != 0) {
+        return;
+      }
+      uint32_t caplen = std::min(packet->GetSize(), o.snapLen);
+      if (active.size() + 16 + caplen > active.capacity()) {
+        owner->Submit(this);
+      }
+      int64_t us = now.GetMicroSeconds();
+      uint32_t header[4] = {uint32_t(us / 1000000), uint32_t(us % 1000000),
+                            caplen, packet->GetSize()};
+      size_t at = active.size();
+      active.resize(at + 16 + caplen);
+      memcpy(&active[at], header, 16);
+      packet->CopyData(&active[at + 16], caplen);
+    }
+  };
+
+  File *Open(const std::string &prefix, Ptr<NetDevice> dev, uint32_t linkType) {
+    std::ostringstream name;
+    name << prefix << "-" << dev->GetNode()->GetId() << "-" << dev->GetIfIndex()
+         << ".pcap";
+    std::unique_ptr<File> file(new File());
+    file->owner = this;
+    file->fd = open(name.str().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    NS_ABORT_MSG_IF(file->fd < 0, "Cannot open " << name.str());
+    file->closed = false;
+    file->busy = false;
+    file->seen = 0;
+    file->active.reserve(size_t(m_options.blockKb) << 10);
+    file->flushing.reserve(size_t(m_options.blockKb) << 10);
+
+    // Global header in host byte order, readers detect it from the magic.
+    uint8_t header[24];
+    uint32_t magic = 0xa1b2c3d4, zero = 0, snapLen = m_options.snapLen;
+    uint16_t major = 2, minor = 4;
+    memcpy(header, &magic, 4);
+    memcpy(header + 4, &major, 2);
+    memcpy(header + 6, &minor, 2);
+    memcpy(header + 8, &zero, 4);
+    memcpy(header + 12, &zero, 4);
+    memcpy(header + 16, &snapLen, 4);
+    memcpy(header + 20, &linkType, 4);
+    WriteAll(file->fd, header, sizeof(header));
+
+    if (!m_writer.joinable()) {
+      m_writer = std::thread(&AsyncPcapHelper::WriterLoop, this);
+    }
+    m_files.push_back(std::move(file));
+    return m_files.back().get();
+  }
+
+  /* Swap the file's blocks and queue the full one for the writer thread,
+   * waiting only if the previous block of this file is still being written. */
+  void Submit(File *file) {
+    if (file->active.empty()) {
+      return;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (file->busy) {
+      m_cv.wait(lock);
+    }
+    file->active.swap(file->flushing);
+    file->busy = true;
+    m_queue.push_back(file);
+    lock.unlock();
+    m_cv.notify_all();
+  }
+
+  void WriterLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+      while (m_queue.empty() && !m_stop) {
+        m_cv.wait(lock);
+      }
+      if (m_queue.empty()) {
+        return;
+      }
+      File *file = m_queue.front();
+      m_queue.pop_front();
+      lock.unlock();
+      WriteAll(file->fd, file->flushing.data(), file->flushing.size());
+      file->flushing.clear();
+      lock.lock();
+      file->busy = false;
+      m_cv.notify_all();
+    }
+  }
+
+  static void WriteAll(int fd, const uint8_t *data, size_t size) {
+    while (size > 0) {
+      ssize_t n = write(fd, data, size);
+      if (n <= 0) {
+        NS_ABORT_MSG_IF(errno != EINTR, "pcap write failed");
+        continue;
+      }
+      data += n;
+      size -= n;
+    }
+  }
+
+  PcapOptions m_options;
+  std::vector<std::unique_ptr<File>> m_files;
+  std::thread m_writer;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::deque<File *> m_queue;
+  bool m_stop;
+};
+
+} // namespace ns3
+
+#endif /* ASYNC_PCAP_H */
@@ -0,0 +1,403 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+#include "sweep-pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fnmatch.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <sys/stat.h>
+
+/*
+ * Performance benchmark of the lab scenarios with a stored baseline, e.g.
+ *
+ *   build/scratch/bench --update     # record bench/baseline.tsv
+ *   build/scratch/bench              # compare against it
+ *
+ * Every case in kCases runs one already-built scenario binary with fixed
+ * sizes and seeds, --repeat times, one run at a time by default so the runs
+ * do not disturb each other. Per case the median of every metric is kept:
+ *
+ *   wall_s        fork to reap of the whole process
+ *   events        simulator events, from the run record
+ *   events_per_s  events / the record's "sim_s" (Simulator::Run only)
+ *   rss_kb        peak resident set size (wait4)
+ *   output_bytes  size of the files the run wrote below its output path
+ *
+ * The baseline is a TSV of "case metric value" lines. A metric that is worse
+ * than its baseline by more than --threshold (relative) is a regression and
+ * makes the exit status 3. A different event count is reported as a
+ * behaviour change: with fixed seeds it should only move when the model
+ * does.
+ */
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("BENCH");
+
+namespace {
+
+struct BenchCase {
+  const char *name;
+  const char *program; // Below --buildDir
+  const char *args;    // {dir} is the case's directory below --workDir
+  const char *output;  // File prefix or directory whose size is measured
+};
+
+const BenchCase kCases[] = {
+    {"lab2-1p1", "lab2-scenario1p1",
+     "--rate=DsssRate11Mbps --seed=15 --run=1 --sta={dir}/sta --ap={dir}/ap",
+     "{dir}"},
+    {"lab2-1p2", "lab2-scenario1p2",
+     "--rate=DsssRate11Mbps --seed=15 --run=1 --sta={dir}/sta --ap={dir}/ap",
+     "{dir}"},
+    {"lab2-2p1", "lab2-scenario2p1",
+     "--rate=DsssRate11Mbps --seed=15 --run=1 --sta={dir}/sta --ap={dir}/ap",
+     "{dir}"},
+    {"lab2-2p2", "lab2-scenario2p2",
+     "--rate=DsssRate11Mbps --seed=15 --run=1 --sta={dir}/sta --ap={dir}/ap",
+     "{dir}"},
+    {"lab3-line6", "LAB3adhoc",
+     "--nWifi=6 --packetSize=1200 --pcapPrefix={dir}/node --verbose=0 "
+     "--RngSeed=1 --RngRun=1",
+     "{dir}"},
+    {"lab3-grid64", "LAB3adhoc",
+     "--nWifi=64 --layout=grid --nFlows=8 --packetSize=1200 --pcap=0 "
+     "--verbose=0 --RngSeed=1 --RngRun=1",
+     ""},
+    {"lab3-disc500", "LAB3adhoc",
+     "--nWifi=500 --layout=disc --nFlows=20 --packetSize=1200 --pcap=0 "
+     "--spatialChannel=1 --propagationCache=1 --verbose=0 --RngSeed=1 "
+     "--RngRun=1",
+     ""},
+    {"lab4-100m", "lab4-scenario",
+     "-x=100 -y=0 -z=0 --simTime=5 --outputPath={dir} --RngSeed=1 --RngRun=1",
+     "{dir}"},
+    {"lab4-2km", "lab4-scenario",
+     "-x=2000 -y=0 -z=0 --simTime=5 --outputPath={dir} --RngSeed=1 "
+     "--RngRun=1",
+     "{dir}"},
+};
+
+/* Metrics in report order; +1 when higher is worse, -1 when lower is. */
+const struct {
+  const char *name;
+  int worse;
+} kMetrics[] = {{"wall_s", 1},
+                {"events_per_s", -1},
+                {"rss_kb", 1},
+                {"output_bytes", 1},
+                {"events", 0}};
+
+typedef std::map<std::string, std::map<std::string, double>> Table;
+
+std::string Replace(std::string s, const std::string &key,
+                    const std::string &value) {
+  for (std::string::size_type pos = s.find(key); pos != std::string::npos;
+       pos = s.find(key, pos + value.size())) {
+    s.replace(pos, key.size(), value);
+  }
+  return s;
+}
+
+double Median(std::vector<double> v) {
+  if (v.empty()) {
+    return 0;
+  }
+  std::sort(v.begin(), v.end());
+  size_t n = v.size();
+  return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+bool Selected(const std::vector<std::string> &patterns,
+              const std::string &name) {
+  if (patterns.empty()) {
+    return true;
+  }
+  for (size_t i = 0; i < patterns.size(); i++) {
+    if (fnmatch(patterns[i].c_str(), name.c_str(), 0) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Table ReadBaseline(const std::string &path) {
+  Table table;
+  std::ifstream in(path.c_str());
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    std::string name, metric;
+    double value;
+    if (line.empty() || line[0] == '#' ||
+        !(fields >> name >> metric >> value)) {
+      continue;
+    }
+    table[name][metric] = value;
+  }
+  return table;
+}
+
+bool WriteBaseline(const std::string &path, const Table &table) {
+  std::ofstream out(path.c_str());
+  out << "# case\tmetric\tvalue (written by build/scratch/bench --update)\n";
+  for (Table::const_iterator c = table.begin(); c != table.end(); c++) {
+    for (std::map<std::string, double>::const_iterator m = c->second.begin();
+         m != c->second.end(); m++) {
+      char value[64];
+      snprintf(value, sizeof(value), "%.6g", m->second);
+      out << c->first << "\t" << m->first << "\t" << value << "\n";
+    }
+  }
+  return bool(out);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string baselinePath("bench/baseline.tsv");
+  bool update = false;
+  double threshold = 0.10;
+  uint32_t repeat = 3;
+  std::string filter;
+  std::string buildDir("build/scratch");
+  std::string workDir("results/bench");
+  std::string libPath("build/lib");
+  std::string output;
+  uint32_t jobs = 1;
+  bool list = false;
+
+  CommandLine cmd;
+  cmd.AddValue("baseline", "TSV with the reference numbers", baselinePath);
+  cmd.AddValue("update", "Store this run's numbers as the baseline", update);
+  cmd.AddValue("threshold", "Relative change that counts as a regression",
+               threshold);
+  cmd.AddValue("repeat", "Runs per case; the median is reported", repeat);
+  cmd.AddValue("filter", "Comma-separated globs of the cases to run", filter);
+  cmd.AddValue("buildDir", "Directory of the built scenario binaries",
+               buildDir);
+  cmd.AddValue("workDir", "Directory for per-case outputs and logs", workDir);
+  cmd.AddValue("libPath", "Prepended to LD_LIBRARY_PATH for the runs", libPath);
+  cmd.AddValue("output", "Markdown file for the report, stdout if empty",
+               output);
+  cmd.AddValue("jobs", "Concurrent runs; more than 1 adds noise", jobs);
+  cmd.AddValue("list", "Print the cases and exit", list);
+  cmd.Parse(argc, argv);
+
+  const size_t nCases = sizeof(kCases) / sizeof(kCases[0]);
+  std::vector<std::string> patterns = SweepSplit(filter, ',');
+  if (list) {
+    for (size_t c = 0; c < nCases; c++) {
+      std::cout << kCases[c].name << "\t" << kCases[c].program << " "
+                << kCases[c].args << std::endl;
+    }
+    return 0;
+  }
+  if (repeat == 0) {
+    std::cerr << "--repeat must be at least 1" << std::endl;
+    return 1;
+  }
+
+  if (!libPath.empty()) {
+    const char *old = getenv("LD_LIBRARY_PATH");
+    std::string value = libPath;
+    if (old != nullptr && *old != '\0') {
+      value += ":" + std::string(old);
+    }
+    setenv("LD_LIBRARY_PATH", value.c_str(), 1);
+  }
+  SweepMakeDirs(workDir);
+
+  // One job per case and repetition, interleaved so that slow drift of the
+  // machine spreads over all cases instead of hitting the last ones.
+  std::vector<SweepJob> queue;
+  std::vector<size_t> caseOf;
+  for (uint32_t r = 0; r < repeat; r++) {
+    for (size_t c = 0; c < nCases; c++) {
+      if (!Selected(patterns, kCases[c].name)) {
+        continue;
+      }
+      std::string dir = workDir + "/" + kCases[c].name;
+      mkdir(dir.c_str(), 0755);
+      SweepJob job;
+      job.tag = queue.size();
+      job.id = std::string(kCases[c].name) + "#" + std::to_string(r);
+      job.argv.push_back(buildDir + "/" + kCases[c].program);
+      std::vector<std::string> args =
+          SweepSplitArgs(Replace(kCases[c].args, "{dir}", dir));
+      job.argv.insert(job.argv.end(), args.begin(), args.end());
+      job.argv.push_back("--output=" + dir + "-" + std::to_string(r) + ".txt");
+      job.logPath = dir + "-" + std::to_string(r) + ".log";
+      queue.push_back(job);
+      caseOf.push_back(c);
+    }
+  }
+  if (queue.empty()) {
+    std::cerr << "No case matches --filter=" << filter << std::endl;
+    return 1;
+  }
+
+  SweepPool pool(std::max<uint32_t>(1, jobs), false);
+  std::cerr << "Benchmarking " << queue.size() / repeat << " cases x "
+            << repeat << " runs on " << pool.Workers() << " workers"
+            << std::endl;
+
+  std::map<std::string, std::map<std::string, std::vector<double>>> samples;
+  std::vector<time_t> started(queue.size(), 0);
+  size_t next = 0;
+  size_t failed = 0;
+  while (next < queue.size() || pool.Running() > 0) {
+    while (next < queue.size() && pool.HasFreeSlot()) {
+      std::string record = queue[next].argv.back().substr(9); // "--output="
+      remove(record.c_str());
+      started[next] = time(nullptr);
+      if (!pool.Launch(queue[next])) {
+        failed++;
+        std::cerr << "[" << queue[next].id << "] fork failed" << std::endl;
+      }
+      next++;
+    }
+    SweepResult r;
+    if (!pool.WaitAny(r)) {
+      continue;
+    }
+    const SweepJob &job = queue[r.tag];
+    const BenchCase &bc = kCases[caseOf[r.tag]];
+    std::vector<std::pair<std::string, double>> values;
+    if (r.status != 0 ||
+        !SweepReadRecord(job.argv.back().substr(9), values)) {
+      failed++;
+      std::cerr << "[" << job.id << "] exit " << r.status << ", see "
+                << job.logPath << std::endl;
+      continue;
+    }
+    std::map<std::string, double> rec(values.begin(), values.end());
+    std::map<std::string, std::vector<double>> &s = samples[bc.name];
+    s["wall_s"].push_back(r.wallSeconds);
+    s["rss_kb"].push_back(r.maxRssKb);
+    if (rec.count("events")) {
+      s["events"].push_back(rec["events"]);
+      if (rec["sim_s"] > 0) {
+        s["events_per_s"].push_back(rec["events"] / rec["sim_s"]);
+      }
+    }
+    std::string out =
+        Replace(bc.output, "{dir}", workDir + "/" + std::string(bc.name));
+    std::vector<std::string> files = SweepOutputFiles(out, started[r.tag]);
+    double bytes = 0;
+    for (size_t f = 0; f < files.size(); f++) {
+      struct stat st;
+      if (stat(files[f].c_str(), &st) == 0) {
+        bytes += st.st_size;
+      }
+    }
+    s["output_bytes"].push_back(bytes);
+    std::cerr << "[" << job.id << "] " << r.wallSeconds << " s" << std::endl;
+  }
+
+  Table current;
+  for (std::map<std::string,
+                std::map<std::string, std::vector<double>>>::const_iterator
+           c = samples.begin();
+       c != samples.end(); c++) {
+    for (std::map<std::string, std::vector<double>>::const_iterator m =
+             c->second.begin();
+         m != c->second.end(); m++) {
+      current[c->first][m->first] = Median(m->second);
+    }
+  }
+
+  Table baseline = ReadBaseline(baselinePath);
+  std::ostringstream md;
+  size_t regressions = 0;
+  md << "| Case | Metric | Baseline | Now | Change | Status |\n";
+  md << "|------|--------|---------:|----:|-------:|--------|\n";
+  for (size_t c = 0; c < nCases; c++) {
+    Table::const_iterator now = current.find(kCases[c].name);
+    if (now == current.end()) {
+      continue;
+    }
+    for (size_t m = 0; m < sizeof(kMetrics) / sizeof(kMetrics[0]); m++) {
+      std::map<std::string, double>::const_iterator v =
+          now->second.find(kMetrics[m].name);
+      if (v == now->second.end()) {
+        continue;
+      }
+      char row[512];
+      Table::const_iterator base = baseline.find(kCases[c].name);
+      if (base == baseline.end() ||
+          base->second.find(kMetrics[m].name) == base->second.end()) {
+        snprintf(row, sizeof(row), "| %s | %s | - | %.6g | - | new |\n",
+                 kCases[c].name, kMetrics[m].name, v->second);
+        md << row;
+        continue;
+      }
+      double ref = base->second.find(kMetrics[m].name)->second;
+      double change = ref != 0 ? (v->second - ref) / std::fabs(ref)
+                               : (v->second != 0 ? INFINITY : 0);
+      const char *status = "ok";
+      if (kMetrics[m].worse == 0) {
+        status = v->second != ref ? "changed" : "ok";
+      } else if (change * kMetrics[m].worse > threshold) {
+        status = "REGRESSION";
+        regressions++;
+      } else if (change * kMetrics[m].worse < -threshold) {
+        status = "improved";
+      }
+      snprintf(row, sizeof(row),
+               "| %s | %s | %.6g | %.6g | %+.1f %% | %s |\n", kCases[c].name,
+               kMetrics[m].name, ref, v->second, 100 * change, status);
+      md << row;
+    }
+  }
+  md << "\n" << current.size() << " cases, " << failed << " failed runs, "
+     << regressions << " regressions beyond " << 100 * threshold << " %\n";
+
+  if (output.empty()) {
+    std::cout << md.str();
+  } else {
+    std::ofstream out(output.c_str());
+    out << md.str();
+  }
+
+  if (update) {
+    // Cases that were not run keep their old numbers.
+    for (Table::const_iterator c = current.begin(); c != current.end(); c++) {
+      baseline[c->first] = c->second;
+    }
+    std::string::size_type slash = baselinePath.rfind('/');
+    if (slash != std::string::npos) {
+      SweepMakeDirs(baselinePath.substr(0, slash));
+    }
+    if (!WriteBaseline(baselinePath, baseline)) {
+      std::cerr << "Cannot write " << baselinePath << std::endl;
+      return 1;
+    }
+    std::cerr << "Baseline written to " << baselinePath << std::endl;
+    return failed ? 1 : 0;
+  }
+  if (failed) {
+    return 1;
+  }
+  return regressions ? 3 : 0;
+}
@@ -0,0 +1,329 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef CACHED_PROPAGATION_H
+#define CACHED_PROPAGATION_H
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/propagation-loss-model.h"
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * Per-link memo of a value that only depends on the positions of the two
+ * ends, indexed by MobilityModel.
+ *
+ * Every mobility model seen gets a dense index on first use; the values live
+ * in 64x64 tiles of a square matrix that are allocated when first touched,
+ * so a chain where only neighbours talk costs memory proportional to its
+ * length while a small BSS ends up in a single tile. A CourseChange of a
+ * model invalidates its row and column.
+ */
+template <typename T> class PropagationPairCache {
+public:
+  explicit PropagationPairCache(T invalid)
+      : m_invalid(invalid), m_dim(0), m_lastA(0), m_lastAIndex(0),
+        m_hits(0), m_misses(0) {}
+
+  ~PropagationPairCache() { Clear(); }
+
+  /* Cached value of the a->b link; `m_invalid` if it has to be computed and
+   * stored through the returned reference. */
+  T &Lookup(Ptr<MobilityModel> a, Ptr<MobilityModel> b) {
+    // YansWifiChannel::Send asks for one sender and all its receivers in a
+    // row, so the sender is usually the one asked for last.
+    uint32_t i;
+    if (PeekPointer(a) == m_lastA) {
+      i = m_lastAIndex;
+    } else {
+      i = Index(a);
+      m_lastA = PeekPointer(a);
+      m_lastAIndex = i;
+    }
+    uint32_t j = Index(b);
+    std::vector<T> &tile = m_tiles[(i >> 6) * m_dim + (j >> 6)];
+    if (tile.empty()) {
+      tile.assign(64 * 64, m_invalid);
+    }
+    T &slot = tile[((i & 63) << 6) | (j & 63)];
+    if (slot == m_invalid) {
+      m_misses++;
+    } else {
+      m_hits++;
+    }
+    return slot;
+  }
+
+  /* Forget every value and stop listening to the mobility models. */
+  void Clear() {
+    for (size_t i = 0; i < m_models.size(); i++) {
+      m_models[i]->TraceDisconnectWithoutContext(
+          "CourseChange",
+          MakeCallback(&PropagationPairCache<T>::CourseChanged, this));
+    }
+    m_models.clear();
+    m_index.clear();
+    m_tiles.clear();
+    m_dim = 0;
+    m_lastA = 0;
+  }
+
+  /* Forget every value but keep the indices, e.g. after a model parameter
+   * changed. */
+  void Flush() {
+    for (size_t t = 0; t < m_tiles.size(); t++) {
+      m_tiles[t].clear();
+    }
+  }
+
+  uint64_t GetHits() const { return m_hits; }
+  uint64_t GetMisses() const { return m_misses; }
+
+private:
+  uint32_t Index(Ptr<MobilityModel> model) {
+    std::unordered_map<const MobilityModel *, uint32_t>::const_iterator it =
+        m_index.find(PeekPointer(model));
+    uint32_t index;
+    if (it != m_index.end()) {
+      index = it->second;
+    } else {
+      index = m_models.size();
+      m_index[PeekPointer(model)] = index;
+      m_models.push_back(model);
+      model->TraceConnectWithoutContext(
+          "CourseChange",
+          MakeCallback(&PropagationPairCache<T>::CourseChanged, this));
+      if (index >= m_dim * 64) {
+        Grow(m_dim ? 2 * m_dim : 1);
+      }
+    }
+    return index;
+  }
+
+  void Grow(uint32_t dim) {
+    std::vector<std::vector<T>> tiles(dim * dim);
+    for (uint32_t r = 0; r < m_dim; r++) {
+      for (uint32_t c = 0; c < m_dim; c++) {
+        tiles[r * dim + c].swap(m_tiles[r * m_dim + c]);
+      }
+    }
+    m_tiles.swap(tiles);
+    m_dim = dim;
+  }
+
+  void CourseChanged(Ptr<const MobilityModel> model) {
+    std::unordered_map<const MobilityModel *, uint32_t>::const_iterator it =
+        m_index.find(PeekPointer(model));
+    if (it == m_index.end()) {
+      return;
+    }
+    uint32_t i = it->second;
+    for (uint32_t t = 0; t < m_dim; t++) {
+      std::vector<T> &row = m_tiles[(i >> 6) * m_dim + t];
+      for (uint32_t k = 0; k < row.size() / 64; k++) {
+        row[((i & 63) << 6) | k] = m_invalid;
+      }
+      std::vector<T> &column = m_tiles[t * m_dim + (i >> 6)];
+      for (uint32_t k = 0; k < column.size() / 64; k++) {
+        column[(k << 6) | (i & 63)] = m_invalid;
+      }
+    }
+  }
+
+  T m_invalid;
+  uint32_t m_dim; // Tiles per matrix row
+  std::vector<std::vector<T>> m_tiles;
+  std::unordered_map<const MobilityModel *, uint32_t> m_index;
+  std::vector<Ptr<MobilityModel>> m_models;
+  const MobilityModel *m_lastA;
+  uint32_t m_lastAIndex;
+  uint64_t m_hits;
+  uint64_t m_misses;
+};
+
+/*
+ * Memoizes the path loss of an inner, deterministic loss model per pair of
+ * mobility models. The loss is stored in dB, so it is reused across transmit
+ * powers; that holds for Friis, TwoRayGround, LogDistance and friends but not
+ * for the fading models, which must not be wrapped.
+ *
+ * The inner model is created from "ModelType" or given with SetModel().
+ * "Frequency" is forwarded to it (0 keeps its own default).
+ */
+class CachedPropagationLossModel : public PropagationLossModel {
+public:
+  static TypeId GetTypeId() {
+    static TypeId tid =
+        TypeId("ns3::CachedPropagationLossModel")
+            .SetParent<PropagationLossModel>()
+            .SetGroupName("Propagation")
+            .AddConstructor<CachedPropagationLossModel>()
+            .AddAttribute(
+                "ModelType", "TypeId name of the cached loss model.",
+                StringValue("ns3::TwoRayGroundPropagationLossModel"),
+                MakeStringAccessor(&CachedPropagationLossModel::SetModelType,
+                                   &CachedPropagationLossModel::GetModelType),
+                MakeStringChecker())
+            .AddAttribute(
+                "Frequency",
+                "Carrier frequency [Hz] set on the cached model, 0 to keep "
+                "its default.",
+                DoubleValue(0),
+                MakeDoubleAccessor(&CachedPropagationLossModel::SetFrequency,
+                                   &CachedPropagationLossModel::GetFrequency),
+                MakeDoubleChecker<double>(0));
+    return tid;
+  }
+
+  CachedPropagationLossModel()
+      : m_frequency(0),
+        m_cache(std::numeric_limits<double>::infinity()) {}
+
+  void SetModel(Ptr<PropagationLossModel> model) {
+    m_model = model;
+    if (m_model != 0 && m_frequency > 0) {
+      m_model->SetAttributeFailSafe("Frequency", DoubleValue(m_frequency));
+    }
+    m_cache.Flush();
+  }
+
+  Ptr<PropagationLossModel> GetModel() const { return m_model; }
+
+  uint64_t GetHits() const { return m_cache.GetHits(); }
+  uint64_t GetMisses() const { return m_cache.GetMisses(); }
+
+private:
+  void SetModelType(std::string name) {
+    ObjectFactory factory;
+    factory.SetTypeId(name);
+    SetModel(factory.Create<PropagationLossModel>());
+  }
+
+  std::string GetModelType() const {
+    return m_model != 0 ? m_model->GetInstanceTypeId().GetName() : "";
+  }
+
+  void SetFrequency(double frequency) {
+    m_frequency = frequency;
+    SetModel(m_model);
+  }
+
+  double GetFrequency() const { return m_frequency; }
+
+  virtual double DoCalcRxPower(double txPowerDbm, Ptr<MobilityModel> a,
+                               Ptr<MobilityModel> b) const {
+    double &loss = m_cache.Lookup(a, b);
+    if (loss == std::numeric_limits<double>::infinity()) {
+      loss = txPowerDbm - m_model->CalcRxPower(txPowerDbm, a, b);
+    }
+    return txPowerDbm - loss;
+  }
+
+  virtual int64_t DoAssignStreams(int64_t stream) {
+    return m_model->AssignStreams(stream);
+  }
+
+  virtual void DoDispose() {
+    m_cache.Clear();
+    m_model = 0;
+    PropagationLossModel::DoDispose();
+  }
+
+  Ptr<PropagationLossModel> m_model;
+  double m_frequency;
+  mutable PropagationPairCache<double> m_cache;
+};
+
+/*
+ * Memoizes the propagation delay of an inner delay model per pair of
+ * mobility models, e.g. to skip the distance computation of
+ * ConstantSpeedPropagationDelayModel on static topologies. Random delay
+ * models must not be wrapped.
+ */
+class CachedPropagationDelayModel : public PropagationDelayModel {
+public:
+  static TypeId GetTypeId() {
+    static TypeId tid =
+        TypeId("ns3::CachedPropagationDelayModel")
+            .SetParent<PropagationDelayModel>()
+            .SetGroupName("Propagation")
+            .AddConstructor<CachedPropagationDelayModel>()
+            .AddAttribute(
+                "ModelType", "TypeId name of the cached delay model.",
+                StringValue("ns3::ConstantSpeedPropagationDelayModel"),
+                MakeStringAccessor(&CachedPropagationDelayModel::SetModelType,
+                                   &CachedPropagationDelayModel::GetModelType),
+                MakeStringChecker());
+    return tid;
+  }
+
+  CachedPropagationDelayModel() : m_cache(-1) {}
+
+  void SetModel(Ptr<PropagationDelayModel> model) {
+    m_model = model;
+    m_cache.Flush();
+  }
+
+  Ptr<PropagationDelayModel> GetModel() const { return m_model; }
+
+  virtual Time GetDelay(Ptr<MobilityModel> a, Ptr<MobilityModel> b) const {
+    int64_t &ticks = m_cache.Lookup(a, b);
+    if (ticks < 0) {
+      ticks = m_model->GetDelay(a, b).GetTimeStep();
+    }
+    return TimeStep(ticks);
+  }
+
+  uint64_t GetHits() const { return m_cache.GetHits(); }
+  uint64_t GetMisses() const { return m_cache.GetMisses(); }
+
+private:
+  void SetModelType(std::string name) {
+    ObjectFactory factory;
+    factory.SetTypeId(name);
+    SetModel(factory.Create<PropagationDelayModel>());
+  }
+
+  std::string GetModelType() const {
+    return m_model != 0 ? m_model->GetInstanceTypeId().GetName() : "";
+  }
+
+  virtual int64_t DoAssignStreams(int64_t stream) {
+    return m_model->AssignStreams(stream);
+  }
+
+  virtual void DoDispose() {
+    m_cache.Clear();
+    m_model = 0;
+    PropagationDelayModel::DoDispose();
+  }
+
+  Ptr<PropagationDelayModel> m_model;
+  mutable PropagationPairCache<int64_t> m_cache;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(CachedPropagationLossModel);
+NS_OBJECT_ENSURE_REGISTERED(CachedPropagationDelayModel);
+
+} // namespace ns3
+
+#endif /* CACHED_PROPAGATION_H */
@@ -0,0 +1,221 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef CACHING_SPECTRUM_CHANNEL_H
+#define CACHING_SPECTRUM_CHANNEL_H
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/spectrum-module.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * MultiModelSpectrumChannel that keeps, per link, the received PSD of the
+ * last transmission.
+ *
+ * For every transmission to every receiver MultiModelSpectrumChannel
+ * converts the PSD to the receiver's spectrum model, computes the angles
+ * and gains of both antennas and the path loss, then copies and scales the
+ * PSD: with 50 RBs and 1 ms TTIs the bulk of the per-subframe cost in LTE,
+ * although between static nodes the result only changes with the transmit
+ * PSD. Here the link (tx PHY, rx PHY) remembers the transmit PSD it last
+ * saw and the received PSD computed from it; while the transmit PSD has
+ * the same spectrum model and values, the receiver gets a copy of the
+ * cached PSD and nothing else is evaluated.
+ *
+ * A CourseChange of any node seen on a link forgets all links, so nodes
+ * that move at a constant velocity in between (WaypointMobilityModel) are
+ * not supported. Call Flush() after changing a loss model or an antenna
+ * attribute during the run. With a SpectrumPropagationLossModel (fading)
+ * the received PSD is not fixed per link and every transmission takes the
+ * MultiModelSpectrumChannel path. The "TxSigParams" trace is not fired.
+ */
+class CachingSpectrumChannel : public MultiModelSpectrumChannel {
+public:
+  static TypeId GetTypeId() {
+    static TypeId tid = TypeId("ns3::CachingSpectrumChannel")
+                            .SetParent<MultiModelSpectrumChannel>()
+                            .SetGroupName("Spectrum")
+                            .AddConstructor<CachingSpectrumChannel>();
+    return tid;
+  }
+
+  CachingSpectrumChannel() : m_hits(0), m_misses(0) {}
+
+  virtual void AddRx(Ptr<SpectrumPhy> phy) {
+    MultiModelSpectrumChannel::AddRx(phy);
+    if (std::find(m_rxPhys.begin(), m_rxPhys.end(), PeekPointer(phy)) ==
+        m_rxPhys.end()) {
+      m_rxPhys.push_back(PeekPointer(phy));
+    }
+  }
+
+  virtual void StartTx(Ptr<SpectrumSignalParameters> txParams) {
+    if (m_spectrumPropagationLoss) {
+      MultiModelSpectrumChannel::StartTx(txParams);
+      return;
+    }
+    Ptr<SpectrumValue> txPsd = txParams->psd;
+    for (size_t i = 0; i < m_rxPhys.size(); i++) {
+      Ptr<SpectrumPhy> rxPhy = m_rxPhys[i];
+      if (rxPhy == txParams->txPhy) {
+        continue;
+      }
+      Link &link = m_links[std::make_pair(PeekPointer(txParams->txPhy),
+                                          PeekPointer(rxPhy))];
+      if (!link.rxPsd || !SameValues(*link.txPsd, *txPsd)) {
+        m_misses++;
+        Compute(link, txParams, rxPhy);
+      } else {
+        m_hits++;
+      }
+      m_pathLossTrace(txParams->txPhy, rxPhy, link.lossDb);
+      if (link.lossDb > m_maxLossDb) {
+        continue;
+      }
+
+      // Copy() copies the PSD too, so let it copy the received one.
+      txParams->psd = link.rxPsd;
+      Ptr<SpectrumSignalParameters> rxParams = txParams->Copy();
+      txParams->psd = txPsd;
+
+      Ptr<NetDevice> netDev = rxPhy->GetDevice();
+      if (netDev) {
+        Simulator::ScheduleWithContext(netDev->GetNode()->GetId(), link.delay,
+                                       &CachingSpectrumChannel::Deliver,
+                                       rxParams, rxPhy);
+      } else {
+        Simulator::Schedule(link.delay, &CachingSpectrumChannel::Deliver,
+                            rxParams, rxPhy);
+      }
+    }
+  }
+
+  /* Forget every cached link. */
+  void Flush() { m_links.clear(); }
+
+  /* Deliveries that reused a cached PSD, and those that computed one. */
+  uint64_t GetHits() const { return m_hits; }
+  uint64_t GetMisses() const { return m_misses; }
+
+private:
+  struct Link {
+    Link() : lossDb(0) {}
+
+    Ptr<SpectrumValue> txPsd; // A copy, senders may reuse theirs
+    Ptr<SpectrumValue> rxPsd;
+    double lossDb; // Including both antenna gains
+    Time delay;
+  };
+
+  static bool SameValues(const SpectrumValue &a, const SpectrumValue &b) {
+    return a.GetSpectrumModelUid() == b.GetSpectrumModelUid() &&
+           std::equal(a.ConstValuesBegin(), a.ConstValuesEnd(),
+                      b.ConstValuesBegin());
+  }
+
+  static void Deliver(Ptr<SpectrumSignalParameters> params,
+                      Ptr<SpectrumPhy> receiver) {
+    receiver->StartRx(params);
+  }
+
+  /* What MultiModelSpectrumChannel::StartTx does for one receiver. */
+  void Compute(Link &link, Ptr<SpectrumSignalParameters> txParams,
+               Ptr<SpectrumPhy> rxPhy) {
+    Ptr<const SpectrumModel> rxModel = rxPhy->GetRxSpectrumModel();
+    Ptr<SpectrumValue> rxPsd;
+    if (txParams->psd->GetSpectrumModelUid() == rxModel->GetUid()) {
+      rxPsd = txParams->psd->Copy();
+    } else {
+      rxPsd = Converter(txParams->psd->GetSpectrumModel(), rxModel)
+                  .Convert(txParams->psd);
+    }
+
+    link.lossDb = 0;
+    link.delay = Seconds(0);
+    Ptr<MobilityModel> txMobility = txParams->txPhy->GetMobility();
+    Ptr<MobilityModel> rxMobility = rxPhy->GetMobility();
+    if (txMobility && rxMobility) {
+      Watch(txMobility);
+      Watch(rxMobility);
+      if (txParams->txAntenna) {
+        link.lossDb -= txParams->txAntenna->GetGainDb(
+            Angles(rxMobility->GetPosition(), txMobility->GetPosition()));
+      }
+      Ptr<AntennaModel> rxAntenna = rxPhy->GetRxAntenna();
+      if (rxAntenna) {
+        link.lossDb -= rxAntenna->GetGainDb(
+            Angles(txMobility->GetPosition(), rxMobility->GetPosition()));
+      }
+      if (m_propagationLoss) {
+        link.lossDb -=
+            m_propagationLoss->CalcRxPower(0, txMobility, rxMobility);
+      }
+      *rxPsd *= std::pow(10.0, -link.lossDb / 10.0);
+      if (m_propagationDelay) {
+        link.delay = m_propagationDelay->GetDelay(txMobility, rxMobility);
+      }
+    }
+    link.txPsd = txParams->psd->Copy();
+    link.rxPsd = rxPsd;
+  }
+
+  const SpectrumConverter &Converter(Ptr<const SpectrumModel> from,
+                                     Ptr<const SpectrumModel> to) {
+    std::pair<SpectrumModelUid_t, SpectrumModelUid_t> key(from->GetUid(),
+                                                          to->GetUid());
+    std::map<std::pair<SpectrumModelUid_t, SpectrumModelUid_t>,
+             SpectrumConverter>::iterator it = m_converters.find(key);
+    if (it == m_converters.end()) {
+      it = m_converters
+               .insert(std::make_pair(key, SpectrumConverter(from, to)))
+               .first;
+    }
+    return it->second;
+  }
+
+  void Watch(Ptr<MobilityModel> mobility) {
+    if (m_watched.insert(PeekPointer(mobility)).second) {
+      mobility->TraceConnectWithoutContext(
+          "CourseChange", MakeCallback(&CachingSpectrumChannel::Moved, this));
+    }
+  }
+
+  void Moved(Ptr<const MobilityModel> mobility) { Flush(); }
+
+  // Kept alive by MultiModelSpectrumChannel
+  std::vector<SpectrumPhy *> m_rxPhys;
+  std::map<std::pair<SpectrumPhy *, SpectrumPhy *>, Link> m_links;
+  std::map<std::pair<SpectrumModelUid_t, SpectrumModelUid_t>,
+           SpectrumConverter>
+      m_converters;
+  std::set<MobilityModel *> m_watched;
+  uint64_t m_hits;
+  uint64_t m_misses;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(CachingSpectrumChannel);
+
+} // namespace ns3
+
+#endif /* CACHING_SPECTRUM_CHANNEL_H */
@@ -0,0 +1,170 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Scaling benchmark for SpatialWifiChannelHelper.
+ *
+ * Builds the LAB3adhoc chain (802.11b ad-hoc, TwoRayGround, 200 m spacing,
+ * 16 dBm, ED -80 dBm / CCA -99 dBm) for every node count in --sizes, sends
+ * --frames broadcast frames from evenly spaced nodes and reports the number
+ * of simulator events per frame with the shared YansWifiChannel and with the
+ * spatially indexed one:
+ *
+ *   ./waf --run "channel-scaling --sizes=6,100,1000,10000"
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/network-module.h"
+#include "ns3/wifi-module.h"
+#include "run-record.h"
+#include "spatial-wifi-channel.h"
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("ChannelScaling");
+
+/* Send one frame; the first one also notes the event count in `before`. */
+static void SendBroadcast(Ptr<WifiNetDevice> dev, uint32_t size,
+                          uint64_t *before) {
+  if (before) {
+    *before = Simulator::GetEventCount();
+  }
+  dev->Send(Create<Packet>(size), Mac48Address::GetBroadcast(), 0x0800);
+}
+
+/* Run one configuration and print its line of the result table. */
+static void RunOnce(uint32_t n, bool spatial, uint32_t frames,
+                    uint32_t packetSize) {
+  WallTimer setup;
+
+  NodeContainer nodes;
+  nodes.Create(n);
+
+  Ptr<YansWifiChannel> channel = CreateObject<YansWifiChannel>();
+  Ptr<TwoRayGroundPropagationLossModel> loss =
+      CreateObject<TwoRayGroundPropagationLossModel>();
+  Ptr<ConstantSpeedPropagationDelayModel> delay =
+      CreateObject<ConstantSpeedPropagationDelayModel>();
+  channel->SetPropagationLossModel(loss);
+  channel->SetPropagationDelayModel(delay);
+
+  YansWifiPhyHelper phy = YansWifiPhyHelper::Default();
+  phy.Set("TxPowerEnd", DoubleValue(16));
+  phy.Set("TxPowerStart", DoubleValue(16));
+  phy.Set("EnergyDetectionThreshold", DoubleValue(-80));
+  phy.Set("CcaMode1Threshold", DoubleValue(-99));
+  phy.Set("ChannelNumber", UintegerValue(7));
+  phy.SetChannel(channel);
+
+  WifiHelper wifi;
+  wifi.SetStandard(WIFI_PHY_STANDARD_80211b);
+  wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager", "DataMode",
+                               StringValue("DsssRate1Mbps"), "ControlMode",
+                               StringValue("DsssRate1Mbps"));
+  WifiMacHelper mac;
+  mac.SetType("ns3::AdhocWifiMac");
+  NetDeviceContainer devices = wifi.Install(phy, mac, nodes);
+
+  MobilityHelper mobility;
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator>();
+  for (uint32_t i = 0; i < n; i++) {
+    positions->Add(Vector(i * 200.0, 0.0, 1.0));
+  }
+  mobility.SetPositionAllocator(positions);
+  mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+  mobility.Install(nodes);
+
+  uint64_t links = uint64_t(n) * (n - 1);
+  if (spatial) {
+    SpatialWifiChannelHelper helper(loss, delay);
+    helper.Install(devices);
+    links = helper.GetLinkCount();
+  }
+
+  // One frame every 50 ms, far longer than a 1 Mbps frame, so the count is
+  // not skewed by collisions and backoff.
+  uint64_t before = 0;
+  for (uint32_t f = 0; f < frames; f++) {
+    uint32_t sender = uint32_t(uint64_t(f) * n / frames);
+    Simulator::Schedule(MilliSeconds(10 + 50 * f), &SendBroadcast,
+                        DynamicCast<WifiNetDevice>(devices.Get(sender)),
+                        packetSize, f == 0 ? &before : nullptr);
+  }
+  Simulator::Stop(MilliSeconds(10 + 50 * frames));
+  double setupSeconds = setup.Seconds();
+
+  // Ad-hoc MACs schedule nothing on their own, so after the first send
+  // (which also skips the Node::Initialize events at t=0) every executed
+  // event but the other sends and the Stop is caused by a transmission.
+  WallTimer sim;
+  Simulator::Run();
+  double simSeconds = sim.Seconds();
+  uint64_t events = Simulator::GetEventCount() - before - frames;
+  Simulator::Destroy();
+
+  printf("| %6u | %-7s | %10llu | %6u | %10llu | %10.1f | %8.3f | %8.3f |\n",
+         n, spatial ? "spatial" : "shared", (unsigned long long)links, frames,
+         (unsigned long long)events, double(events) / frames, setupSeconds,
+         simSeconds);
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+  std::string sizes = "6,10,100,1000,10000";
+  uint32_t frames = 100;
+  uint32_t packetSize = 300;
+  std::string mode = "both";
+
+  CommandLine cmd;
+  cmd.AddValue("sizes", "Comma-separated node counts", sizes);
+  cmd.AddValue("frames", "Broadcast frames sent per configuration", frames);
+  cmd.AddValue("packetSize", "Payload of every frame [bytes]", packetSize);
+  cmd.AddValue("mode", "shared, spatial or both", mode);
+  cmd.Parse(argc, argv);
+
+  if (frames == 0 ||
+      (mode != "shared" && mode != "spatial" && mode != "both")) {
+    std::cerr << "Need --frames > 0 and --mode=shared|spatial|both"
+              << std::endl;
+    return 1;
+  }
+
+  printf("| nodes  | channel | links      | frames | events     | ev/frame   "
+         "| setup_s  | sim_s    |\n");
+  printf("|-------:|---------|-----------:|-------:|-----------:|-----------:"
+         "|---------:|---------:|\n");
+
+  std::istringstream list(sizes);
+  std::string item;
+  while (std::getline(list, item, ',')) {
+    uint32_t n = std::stoul(item);
+    if (n < 2) {
+      continue;
+    }
+    if (mode != "spatial") {
+      RunOnce(n, false, frames, packetSize);
+    }
+    if (mode != "shared") {
+      RunOnce(n, true, frames, packetSize);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,167 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef CONVERGENCE_MONITOR_H
+#define CONVERGENCE_MONITOR_H
+
+#include "ns3/core-module.h"
+#include "run-record.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * Stops the simulation once the delivered throughput has settled.
+ *
+ * Every `interval` the monitor reads a cumulative byte counter and stores the
+ * rate of that interval. The initial transient is cut with MSER-5: samples
+ * are averaged in groups of five and the truncation point minimising the
+ * standard error of the remaining group means is chosen, searching the first
+ * half only. The rest is split into ten batches; once the 95% confidence
+ * half-width of the batch means is within `tolerance` of their mean (and the
+ * truncation point is not at the edge of the search, which would mean the
+ * transient may not be over yet), Simulator::Stop() is called.
+ *
+ * The batches only absorb correlation shorter than themselves, so sources
+ * with long on/off periods need an interval of the same order.
+ */
+class ConvergenceMonitor {
+public:
+  ConvergenceMonitor(Callback<uint64_t> delivered, Time interval,
+                     double tolerance)
+      : m_delivered(delivered), m_interval(interval), m_tolerance(tolerance),
+        m_lastBytes(0), m_converged(false), m_warmup(0), m_mean(0),
+        m_halfWidth(INFINITY) {}
+
+  /* Take the first sample one interval after `start`. */
+  void Start(Time start = Seconds(0)) {
+    Simulator::Schedule(start, &ConvergenceMonitor::Begin, this);
+  }
+
+  /*
+   * "converged" (0/1), "stop_s" (simulated time at the end), "warmup_s"
+   * (truncated transient) and the steady-state rate "steady_mbps" with its
+   * relative 95% half-width "steady_hw".
+   */
+  void Record(RunRecord &record) const {
+    record.Add("converged", m_converged ? 1 : 0);
+    record.Add("stop_s", Simulator::Now().GetSeconds());
+    record.Add("warmup_s", m_warmup * m_interval.GetSeconds());
+    record.Add("steady_mbps", m_mean / 1e6);
+    record.Add("steady_hw", m_mean > 0 ? m_halfWidth / m_mean : INFINITY);
+  }
+
+  bool Converged() const { return m_converged; }
+
+private:
+  static const unsigned kGroup = 5;    // MSER-5
+  static const unsigned kBatches = 10; // t(0.975, 9) below
+  static constexpr double kT9 = 2.262;
+
+  void Begin() {
+    m_lastBytes = m_delivered();
+    m_event =
+        Simulator::Schedule(m_interval, &ConvergenceMonitor::Sample, this);
+  }
+
+  void Sample() {
+    uint64_t bytes = m_delivered();
+    m_samples.push_back((bytes - m_lastBytes) * 8.0 /
+                        m_interval.GetSeconds());
+    m_lastBytes = bytes;
+    if (Check()) {
+      m_converged = true;
+      Simulator::Stop();
+      return;
+    }
+    m_event =
+        Simulator::Schedule(m_interval, &ConvergenceMonitor::Sample, this);
+  }
+
+  bool Check() {
+    // At least two samples per batch even after truncating half.
+    size_t groups = m_samples.size() / kGroup;
+    if (groups < kBatches) {
+      return false;
+    }
+
+    // MSER over the group means, using suffix sums so every candidate
+    // truncation point costs O(1).
+    std::vector<double> z(groups);
+    for (size_t g = 0; g < groups; g++) {
+      double sum = 0;
+      for (size_t i = 0; i < kGroup; i++) {
+        sum += m_samples[g * kGroup + i];
+      }
+      z[g] = sum / kGroup;
+    }
+    std::vector<double> sum(groups + 1, 0), sumSq(groups + 1, 0);
+    for (size_t g = groups; g-- > 0;) {
+      sum[g] = sum[g + 1] + z[g];
+      sumSq[g] = sumSq[g + 1] + z[g] * z[g];
+    }
+    size_t best = 0;
+    double bestMser = INFINITY;
+    for (size_t d = 0; d <= groups / 2; d++) {
+      double n = groups - d;
+      double sse = sumSq[d] - sum[d] * sum[d] / n;
+      double mser = sse / (n * n);
+      if (mser < bestMser) {
+        bestMser = mser;
+        best = d;
+      }
+    }
+    m_warmup = best * kGroup;
+
+    // Batch means over what is left.
+    size_t size = (m_samples.size() - m_warmup) / kBatches;
+    double mean = 0, sq = 0;
+    for (size_t b = 0; b < kBatches; b++) {
+      double batch = 0;
+      for (size_t i = 0; i < size; i++) {
+        batch += m_samples[m_warmup + b * size + i];
+      }
+      batch /= size;
+      mean += batch;
+      sq += batch * batch;
+    }
+    mean /= kBatches;
+    double variance =
+        std::max(0.0, (sq - kBatches * mean * mean) / (kBatches - 1));
+    m_mean = mean;
+    m_halfWidth = kT9 * std::sqrt(variance / kBatches);
+
+    return best < groups / 2 && mean > 0 &&
+           m_halfWidth <= m_tolerance * mean;
+  }
+
+  Callback<uint64_t> m_delivered;
+  Time m_interval;
+  double m_tolerance;
+  uint64_t m_lastBytes;
+  std::vector<double> m_samples; // Rate of every interval [bit/s]
+  EventId m_event;
+  bool m_converged;
+  size_t m_warmup; // Truncated samples
+  double m_mean;   // Steady-state rate [bit/s]
+  double m_halfWidth;
+};
+
+} // namespace ns3
+
+#endif /* CONVERGENCE_MONITOR_H */
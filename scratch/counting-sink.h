@@ -0,0 +1,231 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef COUNTING_SINK_H
+#define COUNTING_SINK_H
+
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+#include "run-record.h"
+#include <algorithm>
+#include <limits>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * Receiver that drains its socket on every arrival and only keeps counters.
+ *
+ * A socket without a receive callback buffers everything up to RcvBufSize
+ * and then drops; this sink reads each packet as soon as it arrives, counts
+ * it against its sender and lets it go. Counters live in a flat vector with
+ * one entry per sending address and port; the sender of the previous packet
+ * is checked first, which is the common case.
+ *
+ * UDP by default; with "Protocol" set to ns3::TcpSocketFactory it listens
+ * and counts every accepted connection as its own flow.
+ */
+class CountingSink : public Application {
+public:
+  struct Counters {
+    uint64_t packets;
+    uint64_t bytes;
+    int64_t first; // Arrival of the first and last packet [time steps]
+    int64_t last;
+  };
+
+  static TypeId GetTypeId() {
+    static TypeId tid =
+        TypeId("ns3::CountingSink")
+            .SetParent<Application>()
+            .SetGroupName("Applications")
+            .AddConstructor<CountingSink>()
+            .AddAttribute("Local", "The address on which to bind the socket.",
+                          AddressValue(),
+                          MakeAddressAccessor(&CountingSink::m_local),
+                          MakeAddressChecker())
+            .AddAttribute("Protocol", "The type of protocol to use.",
+                          TypeIdValue(UdpSocketFactory::GetTypeId()),
+                          MakeTypeIdAccessor(&CountingSink::m_tid),
+                          MakeTypeIdChecker())
+            .AddTraceSource(
+                "Rx", "A packet has been received",
+                MakeTraceSourceAccessor(&CountingSink::m_rxTrace),
+                "ns3::Packet::AddressTracedCallback");
+    return tid;
+  }
+
+  CountingSink() : m_last(0) {}
+
+  /* One entry per sender, in order of first arrival. */
+  const std::vector<Counters> &GetFlows() const { return m_flows; }
+  const std::vector<Address> &GetPeers() const { return m_peers; }
+
+  /*
+   * Add the totals of all CountingSinks in `sinks` to `record`:
+   * "<label>.rx_packets", "<label>.rx_bytes", "<label>.flows" and
+   * "<label>.sink_mbps", the payload rate between the first and the last
+   * arrival.
+   */
+  static void Record(const ApplicationContainer &sinks,
+                     const std::string &label, RunRecord &record) {
+    uint64_t packets = 0, bytes = 0, flows = 0;
+    int64_t first = std::numeric_limits<int64_t>::max();
+    int64_t last = std::numeric_limits<int64_t>::min();
+    for (uint32_t i = 0; i < sinks.GetN(); i++) {
+      Ptr<CountingSink> sink = DynamicCast<CountingSink>(sinks.Get(i));
+      if (sink == 0) {
+        continue;
+      }
+      for (size_t f = 0; f < sink->m_flows.size(); f++) {
+        const Counters &c = sink->m_flows[f];
+        packets += c.packets;
+        bytes += c.bytes;
+        first = std::min(first, c.first);
+        last = std::max(last, c.last);
+        flows++;
+      }
+    }
+    double seconds = last > first ? TimeStep(last - first).GetSeconds() : 0;
+    record.Add(label + ".rx_packets", packets);
+    record.Add(label + ".rx_bytes", bytes);
+    record.Add(label + ".flows", flows);
+    record.Add(label + ".sink_mbps", seconds > 0 ? bytes * 8 / seconds / 1e6
+                                                 : 0.0);
+  }
+
+  /* Bytes received so far by all CountingSinks in `sinks`. */
+  static uint64_t GetRxBytes(ApplicationContainer sinks) {
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < sinks.GetN(); i++) {
+      Ptr<CountingSink> sink = DynamicCast<CountingSink>(sinks.Get(i));
+      for (size_t f = 0; sink != 0 && f < sink->m_flows.size(); f++) {
+        bytes += sink->m_flows[f].bytes;
+      }
+    }
+    return bytes;
+  }
+
+private:
+  virtual void DoDispose() {
+    m_socket = 0;
+    m_accepted.clear();
+    Application::DoDispose();
+  }
+
+  virtual void StartApplication() {
+    m_socket = Socket::CreateSocket(GetNode(), m_tid);
+    NS_ABORT_MSG_IF(m_socket->Bind(m_local) == -1,
+                    "CountingSink failed to bind");
+    m_socket->SetRecvCallback(MakeCallback(&CountingSink::HandleRead, this));
+    if (m_socket->GetSocketType() == Socket::NS3_SOCK_STREAM) {
+      m_socket->Listen();
+      m_socket->SetAcceptCallback(
+          MakeNullCallback<bool, Ptr<Socket>, const Address &>(),
+          MakeCallback(&CountingSink::HandleAccept, this));
+    }
+  }
+
+  virtual void StopApplication() {
+    for (std::list<Ptr<Socket>>::iterator i = m_accepted.begin();
+         i != m_accepted.end(); i++) {
+      (*i)->Close();
+    }
+    if (m_socket != 0) {
+      m_socket->Close();
+      m_socket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket>>());
+    }
+  }
+
+  void HandleAccept(Ptr<Socket> socket, const Address &from) {
+    socket->SetRecvCallback(MakeCallback(&CountingSink::HandleRead, this));
+    m_accepted.push_back(socket);
+  }
+
+  void HandleRead(Ptr<Socket> socket) {
+    Ptr<Packet> packet;
+    Address from;
+    int64_t now = Simulator::Now().GetTimeStep();
+    while ((packet = socket->RecvFrom(from)) && packet->GetSize() > 0) {
+      Counters &c = Lookup(from, now);
+      c.packets++;
+      c.bytes += packet->GetSize();
+      c.last = now;
+      m_rxTrace(packet, from);
+    }
+  }
+
+  Counters &Lookup(const Address &from, int64_t now) {
+    if (m_last < m_peers.size() && m_peers[m_last] == from) {
+      return m_flows[m_last];
+    }
+    std::map<Address, size_t>::const_iterator it = m_index.find(from);
+    if (it != m_index.end()) {
+      m_last = it->second;
+    } else {
+      m_last = m_flows.size();
+      m_index[from] = m_last;
+      m_peers.push_back(from);
+      Counters c = {0, 0, now, now};
+      m_flows.push_back(c);
+    }
+    return m_flows[m_last];
+  }
+
+  Address m_local;
+  TypeId m_tid;
+  Ptr<Socket> m_socket;
+  std::list<Ptr<Socket>> m_accepted;
+  std::vector<Counters> m_flows;
+  std::vector<Address> m_peers;
+  std::map<Address, size_t> m_index;
+  size_t m_last;
+  TracedCallback<Ptr<const Packet>, const Address &> m_rxTrace;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(CountingSink);
+
+/* Counterpart of PacketSinkHelper for CountingSink. */
+class CountingSinkHelper {
+public:
+  CountingSinkHelper(const std::string &protocol, const Address &local) {
+    m_factory.SetTypeId(CountingSink::GetTypeId());
+    m_factory.Set("Protocol", TypeIdValue(TypeId::LookupByName(protocol)));
+    m_factory.Set("Local", AddressValue(local));
+  }
+
+  void SetAttribute(const std::string &name, const AttributeValue &value) {
+    m_factory.Set(name, value);
+  }
+
+  ApplicationContainer Install(Ptr<Node> node) const {
+    Ptr<Application> app = m_factory.Create<Application>();
+    node->AddApplication(app);
+    return ApplicationContainer(app);
+  }
+
+private:
+  ObjectFactory m_factory;
+};
+
+} // namespace ns3
+
+#endif /* COUNTING_SINK_H */
@@ -0,0 +1,591 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+#include "sweep-pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <glob.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+/*
+ * Saturation throughput of the lab2 BSS scenarios from Bianchi's DCF model,
+ * in microseconds instead of a packet-level run, e.g.
+ *
+ *   build/scratch/dcf-predictor                       # whole lab2 grid
+ *   build/scratch/dcf-predictor --scenario=2p2 --rate=DsssRate11Mbps \
+ *       --payload=700 --rts=500
+ *   build/scratch/dcf-predictor --validate="measurements/scenario?.md"
+ *
+ * The scenarios are the lab2 programs with their node positions, flows and
+ * fixed settings (TwoRayGround, 16 dBm, EnergyDetectionThreshold -80 dBm,
+ * 802.11b long preamble, ACKs at --ackRate). Every STA with a flow and, when
+ * it relays STA-to-STA traffic, the AP contend as saturated stations: each
+ * gets the same share of the successful transmissions, the AP's share being
+ * everything that is delivered over two hops. "app" is the payload goodput
+ * per flow and "total" the payload of every data frame the AP sends or
+ * receives, i.e. both hops of relayed traffic, which is how the measurement
+ * tables count it (total ~ 2 x app in scenario 1).
+ *
+ * The model assumes every contender senses every other one and always has
+ * a frame queued. Grid points where that is doubtful are flagged and should
+ * still be simulated:
+ *
+ *   hidden        two contenders are below each other's detection threshold
+ *   edge          a link or sensing pair is within --margin dB of it
+ *   unreachable   a data link is below the threshold
+ *   unsaturated   a source offers less than its predicted share
+ *   ap-bottleneck the AP relays several flows and gets only 1/n of the
+ *                 transmissions for them; its queue drops are not modelled
+ *
+ * --validate reads the hand-made tables of measurements/scenario?.md and
+ * prints the relative error of every value the model predicts.
+ */
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("DCF_PREDICTOR");
+
+namespace {
+
+// 802.11b DSSS timing [us] and contention window.
+const double kSlot = 20;
+const double kSifs = 10;
+const double kDifs = kSifs + 2 * kSlot;
+const double kPlcp = 192; // Long preamble and PLCP header at 1 Mbps
+const uint32_t kCwMin = 31;
+const uint32_t kBackoffStages = 5; // CWmax = 1023 = 32 * 2^5 - 1
+const uint32_t kRetries = 7;       // WifiRemoteStationManager::MaxSsrc
+
+// Frame sizes on air [bytes]; data adds UDP, IPv4, LLC/SNAP, MAC header, FCS.
+const uint32_t kDataOverhead = 8 + 20 + 8 + 24 + 4;
+const uint32_t kAck = 14;
+const uint32_t kRts = 20;
+const uint32_t kCts = 14;
+
+// Shared radio settings of the lab2 programs.
+const double kTxDbm = 16;
+const double kDetectDbm = -80;
+const double kFrequency = 2442e6; // Channel 7
+
+struct Position {
+  double x, y, z;
+};
+
+struct Flow {
+  int src, dst; // Node index, 0 = AP
+};
+
+/* One lab2 program; node 0 is the AP. */
+struct Scenario {
+  const char *name;
+  std::vector<Position> nodes;
+  std::vector<Flow> flows;
+  std::vector<uint32_t> payloads; // Grid values, the first is the default
+  bool rtsOption;                 // Has --rts
+};
+
+std::vector<Scenario> Scenarios() {
+  std::vector<Scenario> s(4);
+  s[0] = {"1p1",
+          {{5, 8.6, 1}, {0, 0, 1}, {10, 0, 1}},
+          {{1, 2}},
+          {1000},
+          false};
+  s[1] = {"1p2",
+          {{5, 8.6, 1}, {0, 0, 1}, {10, 0, 1}, {0, 10, 1}, {10, 10, 1}},
+          {{1, 2}, {3, 4}},
+          {1000},
+          false};
+  s[2] = {"2p1",
+          {{251.1 / 2, 8.6, 1}, {0, 0, 1}, {251.1, 0, 1}},
+          {{1, 2}},
+          {1000, 400, 700},
+          false};
+  s[3] = {"2p2",
+          {{250, 8.6, 1}, {0, 0, 1}, {500, 0, 1}},
+          {{1, 0}, {2, 0}},
+          {1000, 400, 700},
+          true};
+  return s;
+}
+
+const Scenario *FindScenario(const std::vector<Scenario> &all,
+                             const std::string &name) {
+  for (size_t i = 0; i < all.size(); i++) {
+    if (name == all[i].name) {
+      return &all[i];
+    }
+  }
+  return nullptr;
+}
+
+/* "DsssRate5_5Mbps" or "5,5 Mbps" -> 5.5; 0 if not a rate. */
+double RateMbps(std::string name) {
+  std::replace(name.begin(), name.end(), '_', '.');
+  std::replace(name.begin(), name.end(), ',', '.');
+  size_t digit = name.find_first_of("0123456789");
+  return digit == std::string::npos ? 0 : std::atof(name.c_str() + digit);
+}
+
+std::string RateName(double mbps) {
+  std::ostringstream name;
+  name << "DsssRate" << mbps << "Mbps";
+  std::string s = name.str();
+  std::replace(s.begin(), s.end(), '.', '_');
+  return s;
+}
+
+/* TwoRayGroundPropagationLossModel with unit gains, heights and loss. */
+double RxDbm(const Position &a, const Position &b) {
+  double lambda = 299792458.0 / kFrequency;
+  double d = std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) +
+                       (a.z - b.z) * (a.z - b.z));
+  double crossover = 4 * M_PI * a.z * b.z / lambda;
+  if (d <= crossover) {
+    return kTxDbm + 20 * std::log10(lambda / (4 * M_PI * d));
+  }
+  return kTxDbm + 10 * std::log10(a.z * a.z * b.z * b.z / std::pow(d, 4));
+}
+
+/* Duration of `bytes` at `mbps` including the PLCP preamble and header. */
+double TxTime(uint32_t bytes, double mbps) {
+  return kPlcp + std::ceil(bytes * 8 / mbps);
+}
+
+/* Bianchi's per-slot transmission probability for n saturated stations. */
+double SolveTau(uint32_t n, double &collision) {
+  const double w = kCwMin + 1;
+  double lo = 0, hi = 1;
+  for (int i = 0; i < 100; i++) {
+    double tau = (lo + hi) / 2;
+    double p = 1 - std::pow(1 - tau, double(n) - 1);
+    double stages = 0; // sum of (2p)^k for k < m, finite at p = 1/2
+    for (uint32_t k = 0; k < kBackoffStages; k++) {
+      stages += std::pow(2 * p, double(k));
+    }
+    if (tau > 2 / (1 + w + p * w * stages)) {
+      hi = tau;
+    } else {
+      lo = tau;
+    }
+  }
+  double tau = (lo + hi) / 2;
+  collision = 1 - std::pow(1 - tau, double(n) - 1);
+  return tau;
+}
+
+struct GridPoint {
+  const Scenario *scenario;
+  double rate;
+  uint32_t payload;
+  uint32_t rts; // RtsCtsThreshold [bytes]
+};
+
+struct Prediction {
+  uint32_t contenders;
+  double tau;
+  double collision;
+  double total;            // [Mbps] payload through the AP
+  std::vector<double> app; // [Mbps] per flow
+  double success;          // [%] of frames delivered within kRetries
+  std::vector<std::string> flags;
+};
+
+struct Options {
+  double ackRate; // 0 = data rate
+  double offered; // [Mbps] per source while on
+  double duty;    // Share of the time sources are on
+  double margin;  // [dB]
+};
+
+void Flag(Prediction &p, const std::string &flag) {
+  if (std::find(p.flags.begin(), p.flags.end(), flag) == p.flags.end()) {
+    p.flags.push_back(flag);
+  }
+}
+
+Prediction Predict(const GridPoint &c, const Options &o) {
+  const Scenario &s = *c.scenario;
+  Prediction p;
+
+  // Who contends: sources, and the AP when it has to forward.
+  std::vector<bool> contends(s.nodes.size(), false);
+  std::vector<std::pair<int, int>> links;
+  uint32_t relayed = 0;
+  for (size_t f = 0; f < s.flows.size(); f++) {
+    contends[s.flows[f].src] = true;
+    links.push_back(std::make_pair(s.flows[f].src, 0));
+    if (s.flows[f].dst != 0) {
+      contends[0] = true;
+      links.push_back(std::make_pair(0, s.flows[f].dst));
+      relayed++;
+    }
+  }
+  for (size_t l = 0; l < links.size(); l++) {
+    double rx = RxDbm(s.nodes[links[l].first], s.nodes[links[l].second]);
+    if (rx < kDetectDbm) {
+      Flag(p, "unreachable");
+    } else if (rx < kDetectDbm + o.margin) {
+      Flag(p, "edge");
+    }
+  }
+  std::vector<int> stations;
+  for (size_t i = 0; i < s.nodes.size(); i++) {
+    if (contends[i]) {
+      stations.push_back(i);
+    }
+  }
+  for (size_t i = 0; i < stations.size(); i++) {
+    for (size_t j = i + 1; j < stations.size(); j++) {
+      double rx = RxDbm(s.nodes[stations[i]], s.nodes[stations[j]]);
+      if (rx < kDetectDbm) {
+        Flag(p, "hidden");
+      } else if (rx < kDetectDbm + o.margin) {
+        Flag(p, "edge");
+      }
+    }
+  }
+
+  uint32_t n = stations.size();
+  p.contenders = n;
+  p.tau = SolveTau(n, p.collision);
+
+  double ackRate = o.ackRate > 0 ? o.ackRate : c.rate;
+  uint32_t frame = c.payload + kDataOverhead;
+  bool rts = frame > c.rts;
+  double data = TxTime(frame, c.rate);
+  double ack = TxTime(kAck, ackRate);
+  double ts, tc;
+  if (rts) {
+    double rtsTime = TxTime(kRts, c.rate), cts = TxTime(kCts, ackRate);
+    ts = rtsTime + kSifs + cts + kSifs + data + kSifs + ack + kDifs;
+    tc = rtsTime + kSifs + cts + kSlot + kDifs; // CTS timeout
+  } else {
+    ts = data + kSifs + ack + kDifs;
+    tc = data + kSifs + ack + kSlot + kDifs; // ACK timeout
+  }
+  double ptr = 1 - std::pow(1 - p.tau, double(n));
+  double ps = n * p.tau * std::pow(1 - p.tau, double(n) - 1) / ptr;
+  double slot = (1 - ptr) * kSlot + ptr * ps * ts + ptr * (1 - ps) * tc;
+  double perSecond = ptr * ps / slot * 1e6; // Successful exchanges
+
+  p.total = perSecond * c.payload * 8 / 1e6;
+  p.success = 100 * (1 - std::pow(p.collision, double(kRetries)));
+  double share = perSecond / n;
+  if (relayed > 1) {
+    Flag(p, "ap-bottleneck");
+  }
+  for (size_t f = 0; f < s.flows.size(); f++) {
+    // Two-hop flows split the AP's share. With one such flow the AP gets as
+    // many transmissions as the source; with more it has to forward more
+    // than its share and its queue overflows, which the model leaves out.
+    double delivered = s.flows[f].dst != 0 ? share / relayed : share;
+    p.app.push_back(delivered * c.payload * 8 / 1e6);
+    if (o.offered * o.duty < share * c.payload * 8 / 1e6) {
+      Flag(p, "unsaturated");
+    }
+  }
+  return p;
+}
+
+std::string Join(const std::vector<std::string> &items) {
+  std::string s;
+  for (size_t i = 0; i < items.size(); i++) {
+    s += (i ? "," : "") + items[i];
+  }
+  return s;
+}
+
+std::string Fixed(double v, int digits) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.*f", digits, v);
+  return buf;
+}
+
+/* One measured value and the configuration it belongs to. */
+struct Measured {
+  std::string file;
+  GridPoint config;
+  std::string metric; // "total", "app<i>" or "success"
+  double value;
+};
+
+/* "0,860" / "98,147 %" -> 0.860 / 98.147 */
+bool ParseNumber(std::string cell, double &value) {
+  std::replace(cell.begin(), cell.end(), ',', '.');
+  std::istringstream is(cell);
+  return bool(is >> value);
+}
+
+std::vector<std::string> Cells(const std::string &line) {
+  std::vector<std::string> cells = SweepSplit(line, '|');
+  std::vector<std::string> trimmed;
+  for (size_t i = 0; i < cells.size(); i++) {
+    size_t b = cells[i].find_first_not_of(" \t");
+    size_t e = cells[i].find_last_not_of(" \t");
+    if (b != std::string::npos) {
+      trimmed.push_back(cells[i].substr(b, e - b + 1));
+    }
+  }
+  return trimmed;
+}
+
+/*
+ * The tables of measurements/scenario1.md and scenario2.md: sections titled
+ * "<n> nodes, S = <seed>, P = <payload> B", rows per rate or, in part 2 of
+ * scenario 2, per RTS/CTS setting. Which lab2 program a table belongs to
+ * follows from the file, the part and the node count.
+ */
+bool ReadMeasurements(const std::string &path,
+                      const std::vector<Scenario> &scenarios,
+                      std::vector<Measured> &out) {
+  std::ifstream in(path.c_str());
+  if (!in) {
+    return false;
+  }
+  bool second = path.find("scenario2") != std::string::npos;
+  int part = 1;
+  uint32_t nodes = 0, payload = 1000;
+  std::vector<std::string> header;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, 7, "# Part ") == 0) {
+      part = std::atoi(line.c_str() + 7);
+      continue;
+    }
+    size_t comma = line.find(" nodes,");
+    if (comma != std::string::npos) {
+      nodes = std::atoi(line.c_str() + line.find_first_of("0123456789"));
+      size_t pos = line.find("P = ");
+      payload = pos == std::string::npos ? 1000 : std::atoi(&line[pos + 4]);
+      header.clear();
+      continue;
+    }
+    if (line.empty() || line[0] != '|') {
+      header.clear();
+      continue;
+    }
+    std::vector<std::string> cells = Cells(line);
+    if (header.empty()) {
+      header = cells;
+      continue;
+    }
+    if (cells.empty() || cells[0].find("---") != std::string::npos) {
+      continue;
+    }
+    const char *name = second ? (part == 2 ? "2p2" : "2p1")
+                              : (nodes == 4 ? "1p2" : "1p1");
+    GridPoint c = {FindScenario(scenarios, name), 1, payload, 2200};
+    if (header[0].find("Rate") != std::string::npos) {
+      c.rate = RateMbps(cells[0]);
+    } else if (cells[0] == "Enabled") {
+      c.rts = 0;
+    }
+    int app = 0;
+    for (size_t i = 1; i < cells.size() && i < header.size(); i++) {
+      Measured m = {path, c, "", 0};
+      if (header[i].find("Total") == 0) {
+        m.metric = "total";
+      } else if (header[i].find("Application") == 0) {
+        m.metric = "app" + std::to_string(++app);
+      } else if (header[i].find("Success") == 0) {
+        m.metric = "success";
+      } else {
+        continue;
+      }
+      if (ParseNumber(cells[i], m.value)) {
+        out.push_back(m);
+      }
+    }
+  }
+  return true;
+}
+
+double Predicted(const Prediction &p, const std::string &metric) {
+  if (metric == "total") {
+    return p.total;
+  }
+  if (metric == "success") {
+    return p.success;
+  }
+  size_t flow = std::atoi(metric.c_str() + 3) - 1;
+  return flow < p.app.size() ? p.app[flow] : NAN;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string scenario = "all";
+  std::string rate = "all";
+  uint32_t payload = 0;
+  std::string rts = "all";
+  Options o = {0, 20, 10.0 / 15, 1};
+  std::string validate;
+  double tolerance = 0.15;
+  std::string output;
+
+  CommandLine cmd;
+  cmd.AddValue("scenario", "1p1, 1p2, 2p1, 2p2 or all", scenario);
+  cmd.AddValue("rate", "DsssRate{1,2,5_5,11}Mbps or all (1, 5.5 and 11)",
+               rate);
+  cmd.AddValue("payload", "UDP payload [B], 0 = the scenario's lab values",
+               payload);
+  cmd.AddValue("rts", "RtsCtsThreshold [B] of 2p2, or all (off and on)", rts);
+  cmd.AddValue("ackRate", "ACK/CTS rate [Mbps], 0 = the data rate",
+               o.ackRate);
+  cmd.AddValue("offered", "Rate a source offers while on [Mbps]", o.offered);
+  cmd.AddValue("duty", "Share of the time the sources are on", o.duty);
+  cmd.AddValue("margin", "Flag links this close to the threshold [dB]",
+               o.margin);
+  cmd.AddValue("validate", "Compare with these measurement tables (glob)",
+               validate);
+  cmd.AddValue("tolerance", "Relative error that counts as a miss",
+               tolerance);
+  cmd.AddValue("output", "Markdown file for the table, stdout if empty",
+               output);
+  cmd.Parse(argc, argv);
+
+  std::vector<Scenario> scenarios = Scenarios();
+  std::ofstream file;
+  if (!output.empty()) {
+    file.open(output.c_str());
+    if (!file) {
+      std::cerr << "Cannot write " << output << std::endl;
+      return 1;
+    }
+  }
+  std::ostream &out = output.empty() ? std::cout : file;
+
+  if (!validate.empty()) {
+    glob_t g;
+    std::vector<Measured> measured;
+    if (glob(validate.c_str(), 0, nullptr, &g) == 0) {
+      for (size_t i = 0; i < g.gl_pathc; i++) {
+        ReadMeasurements(g.gl_pathv[i], scenarios, measured);
+      }
+    }
+    globfree(&g);
+    if (measured.empty()) {
+      std::cerr << "No measurements in " << validate << std::endl;
+      return 1;
+    }
+    out << "| file | scenario | rate | payload | rts | metric | measured "
+           "| predicted | error | flags |\n";
+    out << "|------|----------|-----:|--------:|----:|--------|---------:"
+           "|----------:|------:|-------|\n";
+    uint32_t trusted = 0, misses = 0;
+    double sumError = 0;
+    for (size_t i = 0; i < measured.size(); i++) {
+      const Measured &m = measured[i];
+      Prediction p = Predict(m.config, o);
+      double predicted = Predicted(p, m.metric);
+      double error = (predicted - m.value) / m.value;
+      if (p.flags.empty()) {
+        trusted++;
+        sumError += std::fabs(error);
+        misses += std::fabs(error) > tolerance;
+      }
+      out << "| " << m.file << " | " << m.config.scenario->name << " | "
+          << m.config.rate << " | " << m.config.payload << " | "
+          << (m.config.rts < 2200 ? "on" : "off") << " | " << m.metric
+          << " | " << Fixed(m.value, 3) << " | " << Fixed(predicted, 3)
+          << " | " << Fixed(100 * error, 1) << "% | " << Join(p.flags)
+          << " |\n";
+    }
+    out << "\n" << trusted << " unflagged values, mean |error| "
+        << Fixed(trusted ? 100 * sumError / trusted : 0, 1) << "%, "
+        << misses << " beyond " << Fixed(100 * tolerance, 0) << "%\n";
+    return 0;
+  }
+
+  std::vector<GridPoint> grid;
+  std::vector<double> rates;
+  if (rate == "all") {
+    rates = {1, 5.5, 11};
+  } else {
+    rates.push_back(RateMbps(rate));
+  }
+  for (size_t s = 0; s < scenarios.size(); s++) {
+    if (scenario != "all" && scenario != scenarios[s].name) {
+      continue;
+    }
+    std::vector<uint32_t> payloads = scenarios[s].payloads;
+    if (payload > 0) {
+      payloads.assign(1, payload);
+    }
+    std::vector<uint32_t> thresholds(1, 2200);
+    if (scenarios[s].rtsOption) {
+      thresholds = rts == "all" ? std::vector<uint32_t>{2200, 0}
+                                : std::vector<uint32_t>{
+                                      uint32_t(std::atoi(rts.c_str()))};
+    }
+    for (size_t r = 0; r < rates.size(); r++) {
+      for (size_t l = 0; l < payloads.size(); l++) {
+        for (size_t t = 0; t < thresholds.size(); t++) {
+          GridPoint c = {&scenarios[s], rates[r], payloads[l], thresholds[t]};
+          grid.push_back(c);
+        }
+      }
+    }
+  }
+  if (grid.empty() || rates[0] <= 0) {
+    std::cerr << "Nothing to predict for --scenario=" << scenario
+              << " --rate=" << rate << std::endl;
+    return 1;
+  }
+
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  std::vector<Prediction> predictions;
+  for (size_t i = 0; i < grid.size(); i++) {
+    predictions.push_back(Predict(grid[i], o));
+  }
+  double us = std::chrono::duration<double, std::micro>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+
+  out << "| scenario | rate | payload | rts | n | tau | p | total | app "
+         "| success | simulate |\n";
+  out << "|----------|------|--------:|----:|--:|----:|--:|------:|-----"
+         "|--------:|----------|\n";
+  uint32_t simulate = 0;
+  for (size_t i = 0; i < grid.size(); i++) {
+    const GridPoint &c = grid[i];
+    const Prediction &p = predictions[i];
+    std::vector<std::string> app;
+    for (size_t f = 0; f < p.app.size(); f++) {
+      app.push_back(Fixed(p.app[f], 3));
+    }
+    simulate += !p.flags.empty();
+    out << "| " << c.scenario->name << " | " << RateName(c.rate) << " | "
+        << c.payload << " | "
+        << (c.payload + kDataOverhead > c.rts ? "on" : "off") << " | "
+        << p.contenders << " | " << Fixed(p.tau, 4) << " | "
+        << Fixed(p.collision, 3) << " | " << Fixed(p.total, 3) << " | "
+        << Join(app) << " | " << Fixed(p.success, 1) << "% | "
+        << (p.flags.empty() ? "no" : Join(p.flags)) << " |\n";
+  }
+  out << "\n"
+      << grid.size() << " points in " << Fixed(us, 1) << " us, " << simulate
+      << " still need a packet-level run\n";
+  return 0;
+}
@@ -0,0 +1,160 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOW_STATS_H
+#define FLOW_STATS_H
+
+#include "ns3/core-module.h"
+#include "ns3/flow-monitor-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+#include "ns3/wifi-module.h"
+#include "run-record.h"
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * In-simulation replacement for the numbers we used to read out of the pcaps
+ * by hand (measurements/scenario1.md and scenario2.md):
+ *
+ *  - "<label>.goodput": application payload throughput of a tracked flow,
+ *  - "<label>.success" / "<label>.loss": received and lost packets in percent
+ *    of the packets sent on that flow,
+ *  - "total": MAC-level throughput as seen by a promiscuous pcap on the
+ *    monitor node, i.e. every frame its PHY sends or successfully receives.
+ *
+ * All rates are in Mbps over the window from `start` to the time Record() is
+ * called, which is the end of the simulation.
+ */
+class FlowStats {
+public:
+  explicit FlowStats(Time start = Seconds(0)) : m_start(start), m_macBytes(0) {
+    m_helper.SetMonitorAttribute("StartTime", TimeValue(start));
+  }
+
+  void Install(NodeContainer nodes) { m_monitor = m_helper.Install(nodes); }
+
+  /* Move the start of the window, e.g. to when traffic can first flow.
+   * FlowMonitor itself keeps counting from the constructor's `start`, so
+   * tracked flows must not send before the new one. */
+  void SetStart(Time start) { m_start = start; }
+
+  /* Report the flows towards dst:port as `label`. Several sources sending to
+   * the same destination, or several Track() calls with the same label, are
+   * summed up. */
+  void Track(const std::string &label, Ipv4Address dst, uint16_t port) {
+    Tracked t;
+    t.label = label;
+    t.dst = dst;
+    t.port = port;
+    m_tracked.push_back(t);
+  }
+
+  /* Count the frames of every Wi-Fi PHY on `node` towards "total". */
+  void MonitorMac(Ptr<Node> node) {
+    for (uint32_t i = 0; i < node->GetNDevices(); i++) {
+      Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>(node->GetDevice(i));
+      if (dev == 0) {
+        continue;
+      }
+      Ptr<WifiPhy> phy = dev->GetPhy();
+      phy->TraceConnectWithoutContext(
+          "PhyTxBegin", MakeCallback(&FlowStats::CountFrame, this));
+      phy->TraceConnectWithoutContext(
+          "PhyRxEnd", MakeCallback(&FlowStats::CountFrame, this));
+    }
+  }
+
+  void Record(RunRecord &record) {
+    double seconds = (Simulator::Now() - m_start).GetSeconds();
+    if (seconds <= 0) {
+      return;
+    }
+    m_monitor->CheckForLostPackets();
+    Ptr<Ipv4FlowClassifier> classifier =
+        DynamicCast<Ipv4FlowClassifier>(m_helper.GetClassifier());
+    FlowMonitor::FlowStatsContainer stats = m_monitor->GetFlowStats();
+
+    // Entries sharing a label are summed and reported once, in the order
+    // their labels were first tracked.
+    std::vector<std::string> labels;
+    std::map<std::string, size_t> labelIndex;
+    std::map<std::pair<Ipv4Address, uint16_t>, size_t> byDestination;
+    for (size_t t = 0; t < m_tracked.size(); t++) {
+      if (labelIndex.find(m_tracked[t].label) == labelIndex.end()) {
+        labelIndex[m_tracked[t].label] = labels.size();
+        labels.push_back(m_tracked[t].label);
+      }
+      byDestination[std::make_pair(m_tracked[t].dst, m_tracked[t].port)] =
+          labelIndex[m_tracked[t].label];
+    }
+
+    std::vector<uint64_t> payload(labels.size()), tx(labels.size()),
+        rx(labels.size()), lost(labels.size());
+    for (FlowMonitor::FlowStatsContainer::const_iterator i = stats.begin();
+         i != stats.end(); i++) {
+      Ipv4FlowClassifier::FiveTuple flow = classifier->FindFlow(i->first);
+      std::map<std::pair<Ipv4Address, uint16_t>, size_t>::const_iterator l =
+          byDestination.find(
+              std::make_pair(flow.destinationAddress, flow.destinationPort));
+      if (l == byDestination.end()) {
+        continue;
+      }
+      // FlowMonitor counts IP packets; strip the IPv4 and transport headers
+      // to get the application payload.
+      uint32_t headers = 20 + (flow.protocol == 17 ? 8 : 20);
+      payload[l->second] +=
+          i->second.rxBytes - uint64_t(i->second.rxPackets) * headers;
+      tx[l->second] += i->second.txPackets;
+      rx[l->second] += i->second.rxPackets;
+      lost[l->second] += i->second.lostPackets;
+    }
+
+    for (size_t l = 0; l < labels.size(); l++) {
+      record.Add(labels[l] + ".goodput", payload[l] * 8 / seconds / 1e6);
+      record.Add(labels[l] + ".success", tx[l] ? 100.0 * rx[l] / tx[l] : 0.0);
+      record.Add(labels[l] + ".loss", tx[l] ? 100.0 * lost[l] / tx[l] : 0.0);
+    }
+    record.Add("total", m_macBytes * 8 / seconds / 1e6);
+  }
+
+private:
+  struct Tracked {
+    std::string label;
+    Ipv4Address dst;
+    uint16_t port;
+  };
+
+  void CountFrame(Ptr<const Packet> packet) {
+    if (Simulator::Now() >= m_start) {
+      m_macBytes += packet->GetSize();
+    }
+  }
+
+  Time m_start;
+  uint64_t m_macBytes;
+  FlowMonitorHelper m_helper;
+  Ptr<FlowMonitor> m_monitor;
+  std::vector<Tracked> m_tracked;
+};
+
+} // namespace ns3
+
+#endif /* FLOW_STATS_H */
@@ -27,6 +27,17 @@
 #include "ns3/propagation-loss-model.h"
 #include "ns3/rng-seed-manager.h"
 #include "ns3/wifi-module.h"
+#include "association-gate.h"
+#include "async-pcap.h"
+#include "cached-propagation.h"
+#include "convergence-monitor.h"
+#include "counting-sink.h"
+#include "flow-stats.h"
+#include "profiling-scheduler.h"
+#include "run-record.h"
+#include "saturating-source.h"
+#include "trace-fingerprint.h"
+#include <functional>
 #include <iostream>
 
 // Default Network Topology
@@ -43,21 +54,40 @@ using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("LAB2");
 
-int main(int argc, char *argv[]) {
+/* Command-line parameters, shared by all replications of one process. */
+struct ScenarioParams {
   uint32_t seed = 15;
-  std::string rate("DsssRate1Mbps");
-  std::string sta_prefix("result/WIFI_STA");
-  std::string ap_prefix("result/WIFI_AP");
-
-  CommandLine cmd;
-  cmd.AddValue("seed", "Seed", seed);
-  cmd.AddValue("rate", "Rate", rate);
-  cmd.AddValue("sta", "STA prefix", sta_prefix);
-  cmd.AddValue("ap", "AP prefix", ap_prefix);
-  cmd.Parse(argc, argv);
+  std::string rate = "DsssRate1Mbps";
+  std::string sta_prefix = "result/WIFI_STA";
+  std::string ap_prefix = "result/WIFI_AP";
+  bool pcap = true;
+  bool saturate = false;
+  bool warmStart = false;
+  double converge = 0;
+  double convergeInterval = 1.0;
+  std::string profile;
+  bool fingerprint = false;
+  std::string fingerprintWindows;
+  bool propagationCache = false;
+  PcapOptions pcapOptions;
+  uint32_t run = 1;
+  uint32_t runs = 1;
+  std::string output;
+};
 
-  /* Seed the random generator */
-  RngSeedManager::SetSeed(seed);
+/*
+ * Builds the topology, simulates it once and adds the outcome to `record`.
+ * Simulator::Destroy tears down the node and channel lists, so every call
+ * starts from an empty simulation.
+ */
+static void RunReplication(const ScenarioParams &p, uint32_t run,
+                           RunRecord &record) {
+  WallTimer setup;
+  if (!p.profile.empty()) {
+    ProfilingScheduler::Enable(p.runs > 1 && p.profile != "-"
+                                   ? p.profile + "-run" + std::to_string(run)
+                                   : p.profile);
+  }
 
   /* Nodes */
   NodeContainer ap;
@@ -78,6 +108,18 @@ int main(int argc, char *argv[]) {
       CreateObject<ConstantSpeedPropagationDelayModel>();
   wifiChannel->SetPropagationDelayModel(
       delayModel); // install propagation delay model
+  if (p.propagationCache) {
+    // Nothing moves, so loss and delay of every STA/AP pair are computed
+    // once instead of for every frame.
+    Ptr<CachedPropagationLossModel> cachedLoss =
+        CreateObject<CachedPropagationLossModel>();
+    cachedLoss->SetModel(lossModel);
+    wifiChannel->SetPropagationLossModel(cachedLoss);
+    Ptr<CachedPropagationDelayModel> cachedDelay =
+        CreateObject<CachedPropagationDelayModel>();
+    cachedDelay->SetModel(delayModel);
+    wifiChannel->SetPropagationDelayModel(cachedDelay);
+  }
 
   Config::SetDefault("ns3::WifiRemoteStationManager::RtsCtsThreshold",
                      StringValue("2200"));
@@ -98,18 +140,19 @@ int main(int argc, char *argv[]) {
 
   Ssid ssid = Ssid("wifi-default");
   wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager", "DataMode",
-                               StringValue(rate), "ControlMode",
-                               StringValue(rate));
+                               StringValue(p.rate), "ControlMode",
+                               StringValue(p.rate));
 
   WifiMacHelper mac = WifiMacHelper();
 
   // setup ap.
   NetDeviceContainer apDevices;
-  mac.SetType("ns3::ApWifiMac", "Ssid", SsidValue(ssid));
+  mac.SetType("ns3::ApWifiMac", "Ssid", SsidValue(ssid), "EnableBeaconJitter",
+              BooleanValue(!p.warmStart));
   apDevices = wifi.Install(phy, mac, ap);
   // setup stas.
   mac.SetType("ns3::StaWifiMac", "Ssid", SsidValue(ssid), "ActiveProbing",
-              BooleanValue(false));
+              BooleanValue(p.warmStart));
   NetDeviceContainer staDevices;
   staDevices = wifi.Install(phy, mac, stas);
 
@@ -151,68 +194,194 @@ int main(int argc, char *argv[]) {
   /* Application part */
   uint16_t dlPort = 1000;
   ApplicationContainer onOffApp;
+  // With --warmStart the sources are only installed, and so only start,
+  // once every STA is associated.
+  std::function<void()> installSources = [&]() {
+    // OnOffApplication, UDP traffic, Please refer the ns-3 API. With
+    // --saturate, same on/off pattern, but a packet is only generated when
+    // the STA's MAC queue has room for it.
+    OnOffSourceHelper source("ns3::UdpSocketFactory", p.saturate);
+    source.SetAttribute(
+        "OnTime",
+        StringValue("ns3::NormalRandomVariable[Mean=10.0|Variance=2.0]"));
+    source.SetAttribute(
+        "OffTime",
+        StringValue("ns3::NormalRandomVariable[Mean=5.0|Variance=1.0]"));
+    source.SetOnOffAttribute(
+        "DataRate", DataRateValue(DataRate("20.0Mbps"))); // Traffic Bit Rate
+    source.SetAttribute("PacketSize", UintegerValue(1000));
 
-  bool ipRecvTos = true;
-  bool ipRecvTtl = true;
+    // Transmitter 0 (ID = 0)
+    onOffApp.Add(source.Install(
+        stas.Get(0), InetSocketAddress(wifiInterfaces.GetAddress(1), dlPort)));
 
-  // Transmitter 0 (ID = 0)
-  OnOffHelper onOffHelper0(
-      "ns3::UdpSocketFactory",
-      InetSocketAddress(
-          wifiInterfaces.GetAddress(1),
-          dlPort)); // OnOffApplication, UDP traffic, Please refer the ns-3 API
-  onOffHelper0.SetAttribute(
-      "OnTime",
-      StringValue("ns3::NormalRandomVariable[Mean=10.0|Variance=2.0]"));
-  onOffHelper0.SetAttribute(
-      "OffTime",
-      StringValue("ns3::NormalRandomVariable[Mean=5.0|Variance=1.0]"));
-  onOffHelper0.SetAttribute(
-      "DataRate", DataRateValue(DataRate("20.0Mbps"))); // Traffic Bit Rate
-  onOffHelper0.SetAttribute("PacketSize", UintegerValue(1000));
-  onOffApp.Add(onOffHelper0.Install(stas.Get(0)));
-
-  // Transmitter 1 (ID = 2)
-  OnOffHelper onOffHelper1(
-      "ns3::UdpSocketFactory",
-      InetSocketAddress(
-          wifiInterfaces.GetAddress(3),
-          dlPort)); // OnOffApplication, UDP traffic, Please refer the ns-3 API
-  onOffHelper1.SetAttribute(
-      "OnTime",
-      StringValue("ns3::NormalRandomVariable[Mean=10.0|Variance=2.0]"));
-  onOffHelper1.SetAttribute(
-      "OffTime",
-      StringValue("ns3::NormalRandomVariable[Mean=5.0|Variance=1.0]"));
-  onOffHelper1.SetAttribute(
-      "DataRate", DataRateValue(DataRate("20.0Mbps"))); // Traffic Bit Rate
-  onOffHelper1.SetAttribute("PacketSize", UintegerValue(1000));
-  onOffApp.Add(onOffHelper1.Install(stas.Get(2)));
+    // Transmitter 1 (ID = 2)
+    onOffApp.Add(source.Install(
+        stas.Get(2), InetSocketAddress(wifiInterfaces.GetAddress(3), dlPort)));
+  };
+  if (!p.warmStart) {
+    installSources();
+  }
 
   // Receiver 0 (ID = 1)
-  TypeId tid0 = TypeId::LookupByName("ns3::UdpSocketFactory");
-  Ptr<Socket> recvSink0 = Socket::CreateSocket(stas.Get(1), tid0);
-  InetSocketAddress local0 =
-      InetSocketAddress(wifiInterfaces.GetAddress(1), dlPort);
-  recvSink0->SetIpRecvTos(ipRecvTos);
-  recvSink0->SetIpRecvTtl(ipRecvTtl);
-  recvSink0->Bind(local0);
+  CountingSinkHelper sinkHelper0(
+      "ns3::UdpSocketFactory",
+      InetSocketAddress(wifiInterfaces.GetAddress(1), dlPort));
+  ApplicationContainer sinkApp0 = sinkHelper0.Install(stas.Get(1));
 
   // Receiver 1 (ID = 3)
-  TypeId tid1 = TypeId::LookupByName("ns3::UdpSocketFactory");
-  Ptr<Socket> recvSink1 = Socket::CreateSocket(stas.Get(3), tid1);
-  InetSocketAddress local1 =
-      InetSocketAddress(wifiInterfaces.GetAddress(3), dlPort);
-  recvSink1->SetIpRecvTos(ipRecvTos);
-  recvSink1->SetIpRecvTtl(ipRecvTtl);
-  recvSink1->Bind(local1);
+  CountingSinkHelper sinkHelper1(
+      "ns3::UdpSocketFactory",
+      InetSocketAddress(wifiInterfaces.GetAddress(3), dlPort));
+  ApplicationContainer sinkApp1 = sinkHelper1.Install(stas.Get(3));
+
+  /* Throughput accounting */
+  FlowStats flowStats;
+  flowStats.Install(NodeContainer(ap, stas));
+  flowStats.Track("app1", wifiInterfaces.GetAddress(1), dlPort);
+  flowStats.Track("app2", wifiInterfaces.GetAddress(3), dlPort);
+  flowStats.MonitorMac(ap.Get(0));
+
+  // Stop before the 100 s once the delivered goodput has settled
+  ApplicationContainer sinks(sinkApp0);
+  sinks.Add(sinkApp1);
+  ConvergenceMonitor monitor(
+      MakeBoundCallback(&CountingSink::GetRxBytes, sinks),
+      Seconds(p.convergeInterval), p.converge);
+  if (p.converge > 0 && !p.warmStart) {
+    monitor.Start();
+  }
+
+  AssociationGate gate;
+  if (p.warmStart) {
+    gate.Watch(staDevices);
+    gate.OnReady(installSources);
+    gate.OnReady([&]() {
+      flowStats.SetStart(Simulator::Now());
+      if (p.converge > 0) {
+        monitor.Start();
+      }
+    });
+    gate.Start();
+  }
+
+  TraceFingerprint fingerprint;
+  if (p.fingerprint || !p.fingerprintWindows.empty()) {
+    fingerprint.ConnectWifi();
+    fingerprint.ConnectApps(sinks);
+  }
 
   Simulator::Stop(Seconds(100.0));
   /* PCAP tracing */
-  phy.EnablePcap(sta_prefix, stas, true);
-  phy.EnablePcap(ap_prefix, ap, true);
+  AsyncPcapHelper asyncPcap(p.pcapOptions);
+  if (p.pcap) {
+    std::string suffix = p.runs > 1 ? "-run" + std::to_string(run) : "";
+    if (p.pcapOptions.async) {
+      asyncPcap.EnableWifi(p.sta_prefix + suffix, stas);
+      asyncPcap.EnableWifi(p.ap_prefix + suffix, ap);
+    } else {
+      phy.EnablePcap(p.sta_prefix + suffix, stas, true);
+      phy.EnablePcap(p.ap_prefix + suffix, ap, true);
+    }
+  }
 
+  double setupSeconds = setup.Seconds();
+  WallTimer sim;
   Simulator::Run();
+  asyncPcap.Close();
+  record.Add("setup_s", setupSeconds);
+  record.Add("sim_s", sim.Seconds());
+  record.Add("events", Simulator::GetEventCount());
+  flowStats.Record(record);
+  if (p.warmStart) {
+    gate.Record(record);
+  }
+  CountingSink::Record(sinkApp0, "app1", record);
+  CountingSink::Record(sinkApp1, "app2", record);
+  if (p.converge > 0) {
+    monitor.Record(record);
+  }
+  if (p.fingerprint || !p.fingerprintWindows.empty()) {
+    fingerprint.Record(record);
+  }
+  if (!p.fingerprintWindows.empty()) {
+    fingerprint.WriteWindows(p.runs > 1 && p.fingerprintWindows != "-"
+                                 ? p.fingerprintWindows + "-run" +
+                                       std::to_string(run)
+                                 : p.fingerprintWindows);
+  }
   Simulator::Destroy();
+}
+
+int main(int argc, char *argv[]) {
+  ScenarioParams p;
+
+  CommandLine cmd;
+  cmd.AddValue("seed", "Seed", p.seed);
+  cmd.AddValue("rate", "Rate", p.rate);
+  cmd.AddValue("sta", "STA prefix", p.sta_prefix);
+  cmd.AddValue("ap", "AP prefix", p.ap_prefix);
+  cmd.AddValue("pcap", "Write pcap traces of all STAs and the AP", p.pcap);
+  p.pcapOptions.AddValues(cmd);
+  cmd.AddValue("saturate",
+               "Only generate packets when the MAC queue has room instead of "
+               "offering 20 Mbps",
+               p.saturate);
+  cmd.AddValue("warmStart",
+               "Probe actively and start traffic and measurements once all "
+               "STAs are associated",
+               p.warmStart);
+  cmd.AddValue("converge",
+               "Stop early once the 95% CI of the goodput is within this "
+               "fraction of its mean, 0 = always simulate 100 s",
+               p.converge);
+  cmd.AddValue("convergeInterval", "Goodput sampling interval [s]",
+               p.convergeInterval);
+  cmd.AddValue("profile",
+               "Write wall time per event type and per simulated second to "
+               "this file (\"-\" = stdout)",
+               p.profile);
+  cmd.AddValue("fingerprint",
+               "Add a hash of all PHY, MAC drop and receive events to the "
+               "record",
+               p.fingerprint);
+  cmd.AddValue("fingerprintWindows",
+               "Also write one hash per simulated second to this file",
+               p.fingerprintWindows);
+  cmd.AddValue("propagationCache", "Memoize loss and delay per node pair",
+               p.propagationCache);
+  cmd.AddValue("run", "First RngSeedManager run number", p.run);
+  cmd.AddValue("runs", "Replications simulated in this process", p.runs);
+  cmd.AddValue("output", "File the per-run records are appended to",
+               p.output);
+  cmd.Parse(argc, argv);
+
+  /* Seed the random generator */
+  RngSeedManager::SetSeed(p.seed);
+
+  // Library loading, TypeId registration and option parsing happen once per
+  // process; with --runs=N they are shared by all N replications.
+  double startup = ProcessUptimeSeconds();
+  WallTimer total;
+
+  for (uint32_t run = p.run; run < p.run + p.runs; run++) {
+    RngSeedManager::SetRun(run);
+    // Hand out the same stream indices as a fresh process would, so run k
+    // here reproduces a separate "--run=k" invocation.
+    RngSeedManager::ResetNextStreamIndex();
+
+    RunRecord record;
+    record.Add("run", run);
+    record.Add("seed", RngSeedManager::GetSeed());
+    RunReplication(p, run, record);
+    record.Write(p.output);
+  }
+
+  if (p.runs > 1) {
+    std::cerr << "Process startup took " << startup << " s and was paid once "
+              << "instead of " << p.runs << " times (" << startup * (p.runs - 1)
+              << " s saved); mean wall time per replication "
+              << total.Seconds() / p.runs << " s" << std::endl;
+  }
   return 0;
 };
@@ -0,0 +1,495 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+#include "sweep-pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Throughput coverage map of lab4-scenario: runs the scenario with the UE at
+ * the points of an (x, y) grid, one layer per --z value, in a bounded
+ * worker pool, and gathers the mean DL PDCP throughput of every run, e.g.
+ *
+ *   build/scratch/lab4-grid-sweep --x=-5000:5000 --y=-5000:5000 --step=250 \
+ *     --args="--simTime=5 --antennaType=CosineAntennaModel" \
+ *     --csv=results/lab4-grid/map.csv --binary=results/lab4-grid/map.bin
+ *
+ * The grid is refined adaptively instead of being simulated point by point.
+ * Only the corners of cells 2^--levels steps wide are simulated first (the
+ * grid is extended upwards to fit whole cells). A cell whose corners differ
+ * by at most --threshold Mbps is taken to be uniform and its inner points
+ * are interpolated bilinearly; every other cell is split into four, whose
+ * new corners are simulated in the next round, down to single steps. The
+ * corners of a cell only sample it, so a feature smaller than the coarse
+ * cells can be missed; use fewer levels where that matters.
+ *
+ * Every run writes its statistics to <workDir>/<x>_<y>_<z>/. The mean
+ * throughput is the received PDCP bytes of all bearers over the span of the
+ * DlPdcpStats.txt epochs. Run directories are removed once read unless
+ * --keep is set.
+ *
+ * --csv gets one "x,y,z,mbps,simulated" line per grid point. --binary gets
+ * a little-endian header (char[4] "HMAP", uint32 nx, ny, nz, double x0, y0,
+ * step, then nz doubles with the z values) followed by nz * ny * nx float32
+ * Mbps values, x fastest. Points whose run failed are NaN.
+ */
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("LAB4GRID");
+
+namespace {
+
+/* Statistics files LteHelper::EnableTraces() writes besides the ones under
+ * lab4-scenario's --outputPath. */
+const char *const kPhyStats[][2] = {
+    {"PhyStatsCalculator::DlRsrpSinrFilename", "DlRsrpSinrStats.txt"},
+    {"PhyStatsCalculator::UlSinrFilename", "UlSinrStats.txt"},
+    {"PhyStatsCalculator::UlInterferenceFilename", "UlInterferenceStats.txt"},
+    {"PhyTxStatsCalculator::DlTxOutputFilename", "DlTxPhyStats.txt"},
+    {"PhyTxStatsCalculator::UlTxOutputFilename", "UlTxPhyStats.txt"},
+    {"PhyRxStatsCalculator::DlRxOutputFilename", "DlRxPhyStats.txt"},
+    {"PhyRxStatsCalculator::UlRxOutputFilename", "UlRxPhyStats.txt"}};
+
+/* Parse "min:max" (or a single value) into integers. */
+bool ParseRange(const std::string &s, int32_t &lo, int32_t &hi) {
+  std::vector<std::string> parts = SweepSplit(s, ':');
+  if (parts.empty() || parts.size() > 2) {
+    return false;
+  }
+  char *end = nullptr;
+  lo = strtol(parts[0].c_str(), &end, 10);
+  if (*end != '\0') {
+    return false;
+  }
+  hi = lo;
+  if (parts.size() == 2) {
+    hi = strtol(parts[1].c_str(), &end, 10);
+    if (*end != '\0') {
+      return false;
+    }
+  }
+  return hi >= lo;
+}
+
+/* Points of one axis from `lo` covering `hi` in whole cells of `cell`
+ * steps; 1 when the axis has no extent. */
+uint32_t AxisPoints(int32_t lo, int32_t hi, uint32_t step, uint32_t cell) {
+  if (hi == lo) {
+    return 1;
+  }
+  uint32_t steps = (uint32_t(hi - lo) + step - 1) / step;
+  return (steps + cell - 1) / cell * cell + 1;
+}
+
+/* Mean received DL PDCP throughput [Mbps] in `path`, NaN if unreadable. */
+double PdcpMbps(const std::string &path) {
+  std::ifstream in(path.c_str());
+  std::string line;
+  double first = INFINITY, last = -INFINITY, bytes = 0;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '%') {
+      continue;
+    }
+    // start end CellId IMSI RNTI LCID nTxPDUs TxBytes nRxPDUs RxBytes ...
+    std::istringstream fields(line);
+    double start, end, value;
+    std::string skip;
+    if (!(fields >> start >> end)) {
+      continue;
+    }
+    for (int c = 2; c < 9; c++) {
+      fields >> skip;
+    }
+    if (!(fields >> value)) {
+      continue;
+    }
+    first = std::min(first, start);
+    last = std::max(last, end);
+    bytes += value;
+  }
+  return last > first ? bytes * 8 / (last - first) / 1e6
+                      : std::numeric_limits<double>::quiet_NaN();
+}
+
+void RemoveRunDir(const std::string &dir) {
+  std::vector<std::string> files = SweepOutputFiles(dir, 0);
+  for (size_t i = 0; i < files.size(); i++) {
+    remove(files[i].c_str());
+  }
+  rmdir(dir.c_str());
+}
+
+class GridSweep {
+public:
+  GridSweep(int32_t x0, int32_t y0, uint32_t nx, uint32_t ny,
+            const std::vector<int32_t> &zs, uint32_t step)
+      : m_x0(x0), m_y0(y0), m_nx(nx), m_ny(ny), m_zs(zs), m_step(step),
+        m_mbps(nx * ny * zs.size(), std::numeric_limits<double>::quiet_NaN()),
+        m_state(m_mbps.size(), UNKNOWN) {}
+
+  size_t Index(uint32_t i, uint32_t j, size_t layer) const {
+    return (layer * m_ny + j) * m_nx + i;
+  }
+
+  int32_t X(size_t index) const {
+    return m_x0 + int32_t(index % m_nx * m_step);
+  }
+  int32_t Y(size_t index) const {
+    return m_y0 + int32_t(index / m_nx % m_ny * m_step);
+  }
+  int32_t Z(size_t index) const { return m_zs[index / (m_nx * m_ny)]; }
+
+  /* "<x>_<y>_<z>", the name of the point's run directory. */
+  std::string Id(size_t index) const {
+    return std::to_string(X(index)) + "_" + std::to_string(Y(index)) + "_" +
+           std::to_string(Z(index));
+  }
+
+  /* Whether the point still needs a run; marks it as taken. */
+  bool Claim(size_t index) {
+    if (m_state[index] == SIMULATED || m_state[index] == QUEUED) {
+      return false;
+    }
+    m_state[index] = QUEUED;
+    return true;
+  }
+
+  void SetSimulated(size_t index, double mbps) {
+    m_mbps[index] = mbps;
+    m_state[index] = SIMULATED;
+  }
+
+  /*
+   * Look at the cell with lower corner (i, j) and `cell` steps per side.
+   * Uniform cells get their unsimulated inner points interpolated and
+   * true is returned; otherwise the caller refines.
+   */
+  bool Settle(uint32_t i, uint32_t j, size_t layer, uint32_t cell,
+              double threshold) {
+    uint32_t si = m_nx > 1 ? cell : 0, sj = m_ny > 1 ? cell : 0;
+    double c00 = m_mbps[Index(i, j, layer)];
+    double c10 = m_mbps[Index(i + si, j, layer)];
+    double c01 = m_mbps[Index(i, j + sj, layer)];
+    double c11 = m_mbps[Index(i + si, j + sj, layer)];
+    // A failed run (NaN) makes the cell non-uniform
+    if (std::isnan(c00) || std::isnan(c10) || std::isnan(c01) ||
+        std::isnan(c11)) {
+      return false;
+    }
+    double lo = std::min(std::min(c00, c10), std::min(c01, c11));
+    double hi = std::max(std::max(c00, c10), std::max(c01, c11));
+    if (hi - lo > threshold) {
+      return false;
+    }
+    for (uint32_t b = 0; b <= sj; b++) {
+      for (uint32_t a = 0; a <= si; a++) {
+        size_t k = Index(i + a, j + b, layer);
+        if (m_state[k] != UNKNOWN && m_state[k] != INTERPOLATED) {
+          continue;
+        }
+        double u = si ? double(a) / si : 0, v = sj ? double(b) / sj : 0;
+        m_mbps[k] = (1 - u) * (1 - v) * c00 + u * (1 - v) * c10 +
+                    (1 - u) * v * c01 + u * v * c11;
+        m_state[k] = INTERPOLATED;
+      }
+    }
+    return true;
+  }
+
+  size_t Count(int state) const {
+    size_t n = 0;
+    for (size_t k = 0; k < m_state.size(); k++) {
+      n += m_state[k] == state;
+    }
+    return n;
+  }
+
+  bool WriteCsv(const std::string &path) const {
+    std::ofstream out(path.c_str());
+    out << "x,y,z,mbps,simulated\n";
+    for (size_t layer = 0; layer < m_zs.size(); layer++) {
+      for (uint32_t j = 0; j < m_ny; j++) {
+        for (uint32_t i = 0; i < m_nx; i++) {
+          size_t k = Index(i, j, layer);
+          out << X(k) << "," << Y(k) << "," << Z(k) << ","
+              << m_mbps[k] << "," << (m_state[k] == SIMULATED ? 1 : 0)
+              << "\n";
+        }
+      }
+    }
+    return bool(out);
+  }
+
+  bool WriteBinary(const std::string &path) const {
+    std::ofstream out(path.c_str(), std::ios::binary);
+    uint32_t dims[3] = {m_nx, m_ny, uint32_t(m_zs.size())};
+    double origin[3] = {double(m_x0), double(m_y0), double(m_step)};
+    out.write("HMAP", 4);
+    out.write(reinterpret_cast<const char *>(dims), sizeof(dims));
+    out.write(reinterpret_cast<const char *>(origin), sizeof(origin));
+    for (size_t layer = 0; layer < m_zs.size(); layer++) {
+      double z = m_zs[layer];
+      out.write(reinterpret_cast<const char *>(&z), sizeof(z));
+    }
+    std::vector<float> values(m_mbps.begin(), m_mbps.end());
+    out.write(reinterpret_cast<const char *>(values.data()),
+              values.size() * sizeof(float));
+    return bool(out);
+  }
+
+  uint32_t Nx() const { return m_nx; }
+  uint32_t Ny() const { return m_ny; }
+  const std::vector<int32_t> &Zs() const { return m_zs; }
+
+  enum { UNKNOWN, QUEUED, SIMULATED, INTERPOLATED };
+
+private:
+  int32_t m_x0, m_y0;
+  uint32_t m_nx, m_ny;
+  std::vector<int32_t> m_zs;
+  uint32_t m_step;
+  std::vector<double> m_mbps;
+  std::vector<char> m_state;
+};
+
+/* A cell of the current round: lower corner and layer. */
+struct Cell {
+  uint32_t i, j;
+  size_t layer;
+};
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string program("build/scratch/lab4-scenario");
+  std::string extraArgs;
+  std::string xRange("-5000:5000");
+  std::string yRange("0");
+  std::string zList("1");
+  uint32_t step = 250;
+  uint32_t levels = 3;
+  double threshold = 1;
+  std::string workDir("results/lab4-grid/runs");
+  std::string csv("results/lab4-grid/map.csv");
+  std::string binary;
+  std::string libPath("build/lib");
+  bool keep = false;
+  uint32_t jobs = 0;
+  bool pin = false;
+
+  CommandLine cmd;
+  cmd.AddValue("program", "Path of the built lab4-scenario binary", program);
+  cmd.AddValue("args", "Extra arguments passed to every run", extraArgs);
+  cmd.AddValue("x", "UE x range \"min:max\" [m]", xRange);
+  cmd.AddValue("y", "UE y range \"min:max\" [m]", yRange);
+  cmd.AddValue("z", "UE heights, comma-separated [m]", zList);
+  cmd.AddValue("step", "Grid spacing [m]", step);
+  cmd.AddValue("levels", "Refinement levels: first runs are 2^levels steps "
+                         "apart, 0 = simulate every point",
+               levels);
+  cmd.AddValue("threshold", "Largest throughput difference [Mbps] between "
+                            "the corners of a cell that is not refined",
+               threshold);
+  cmd.AddValue("workDir", "Directory for the per-run outputs and logs",
+               workDir);
+  cmd.AddValue("keep", "Keep the per-run output directories", keep);
+  cmd.AddValue("csv", "CSV heatmap, \"\" for none", csv);
+  cmd.AddValue("binary", "Binary heatmap, \"\" for none", binary);
+  cmd.AddValue("libPath", "Prepended to LD_LIBRARY_PATH for the runs", libPath);
+  cmd.AddValue("jobs", "Concurrent runs, 0 = one per online CPU", jobs);
+  cmd.AddValue("pin", "Pin every worker slot to its own CPU", pin);
+  cmd.Parse(argc, argv);
+
+  int32_t xMin, xMax, yMin, yMax;
+  if (!ParseRange(xRange, xMin, xMax) || !ParseRange(yRange, yMin, yMax)) {
+    std::cerr << "--x and --y take \"min:max\" with min <= max" << std::endl;
+    return 1;
+  }
+  std::vector<int32_t> zs;
+  std::vector<std::string> zParts = SweepSplit(zList, ',');
+  for (size_t k = 0; k < zParts.size(); k++) {
+    zs.push_back(atoi(zParts[k].c_str()));
+  }
+  if (zs.empty() || step == 0 || levels > 16) {
+    std::cerr << "Need at least one --z, --step > 0 and --levels <= 16"
+              << std::endl;
+    return 1;
+  }
+
+  if (!libPath.empty()) {
+    const char *old = getenv("LD_LIBRARY_PATH");
+    std::string value = libPath;
+    if (old != nullptr && *old != '\0') {
+      value += ":" + std::string(old);
+    }
+    setenv("LD_LIBRARY_PATH", value.c_str(), 1);
+  }
+  SweepMakeDirs(workDir);
+
+  uint32_t cell = 1u << levels;
+  GridSweep grid(xMin, yMin, AxisPoints(xMin, xMax, step, cell),
+                 AxisPoints(yMin, yMax, step, cell), zs, step);
+  std::vector<std::string> extra = SweepSplitArgs(extraArgs);
+  SweepPool pool(jobs, pin);
+  std::cerr << "Grid " << grid.Nx() << " x " << grid.Ny() << " x "
+            << zs.size() << " on " << pool.Workers() << " workers, cells of "
+            << cell << " steps" << std::endl;
+
+  // First round: the corners of all coarse cells.
+  std::vector<Cell> cells;
+  std::vector<size_t> points;
+  for (size_t layer = 0; layer < zs.size(); layer++) {
+    for (uint32_t j = 0; j < grid.Ny(); j += cell) {
+      for (uint32_t i = 0; i < grid.Nx(); i += cell) {
+        size_t k = grid.Index(i, j, layer);
+        if (grid.Claim(k)) {
+          points.push_back(k);
+        }
+        if ((grid.Nx() == 1 || i + cell < grid.Nx()) &&
+            (grid.Ny() == 1 || j + cell < grid.Ny())) {
+          Cell c = {i, j, layer};
+          cells.push_back(c);
+        }
+      }
+    }
+  }
+
+  size_t failed = 0;
+  for (;;) {
+    // Simulate the points of this round.
+    size_t next = 0;
+    while (next < points.size() || pool.Running() > 0) {
+      while (next < points.size() && pool.HasFreeSlot()) {
+        size_t k = points[next++];
+        std::string dir = workDir + "/" + grid.Id(k);
+        SweepMakeDirs(dir);
+        SweepJob job;
+        job.id = grid.Id(k);
+        job.tag = k;
+        job.argv.push_back(program);
+        job.argv.insert(job.argv.end(), extra.begin(), extra.end());
+        job.argv.push_back("-x=" + std::to_string(grid.X(k)));
+        job.argv.push_back("-y=" + std::to_string(grid.Y(k)));
+        job.argv.push_back("-z=" + std::to_string(grid.Z(k)));
+        job.argv.push_back("--outputPath=" + dir);
+        // The PHY statistics go to the working directory, which all runs
+        // share, unless told otherwise.
+        for (size_t f = 0; f < sizeof(kPhyStats) / sizeof(kPhyStats[0]);
+             f++) {
+          job.argv.push_back(std::string("--ns3::") + kPhyStats[f][0] + "=" +
+                             dir + "/" + kPhyStats[f][1]);
+        }
+        job.logPath = dir + ".log";
+        if (!pool.Launch(job)) {
+          grid.SetSimulated(k, std::numeric_limits<double>::quiet_NaN());
+          failed++;
+          std::cerr << "[" << job.id << "] fork failed" << std::endl;
+        }
+      }
+
+      SweepResult r;
+      if (!pool.WaitAny(r)) {
+        continue;
+      }
+      std::string dir = workDir + "/" + grid.Id(r.tag);
+      double mbps = r.status == 0 ? PdcpMbps(dir + "/DlPdcpStats.txt")
+                                  : std::numeric_limits<double>::quiet_NaN();
+      if (std::isnan(mbps)) {
+        failed++;
+        std::cerr << "[" << grid.Id(r.tag) << "] exit " << r.status
+                  << ", no PDCP throughput" << std::endl;
+      }
+      grid.SetSimulated(r.tag, mbps);
+      if (!keep) {
+        RemoveRunDir(dir);
+      }
+    }
+    std::cerr << "Cells of " << cell << " steps: " << points.size()
+              << " runs, " << grid.Count(GridSweep::SIMULATED)
+              << " simulated so far" << std::endl;
+
+    if (cell == 1) {
+      break;
+    }
+
+    // Interpolate uniform cells, split the others and queue their new
+    // corners.
+    uint32_t half = cell / 2;
+    std::vector<Cell> refined;
+    points.clear();
+    for (size_t c = 0; c < cells.size(); c++) {
+      const Cell &p = cells[c];
+      if (grid.Settle(p.i, p.j, p.layer, cell, threshold)) {
+        continue;
+      }
+      uint32_t si = grid.Nx() > 1 ? half : 0, sj = grid.Ny() > 1 ? half : 0;
+      for (uint32_t b = 0; b <= 2 * sj; b += half) {
+        for (uint32_t a = 0; a <= 2 * si; a += half) {
+          size_t k = grid.Index(p.i + a, p.j + b, p.layer);
+          if (grid.Claim(k)) {
+            points.push_back(k);
+          }
+          if (a < 2 * si + (si == 0) && b < 2 * sj + (sj == 0)) {
+            Cell sub = {p.i + a, p.j + b, p.layer};
+            refined.push_back(sub);
+          }
+        }
+      }
+    }
+    cells.swap(refined);
+    cell = half;
+  }
+
+  size_t simulated = grid.Count(GridSweep::SIMULATED);
+  size_t total = grid.Nx() * grid.Ny() * zs.size();
+  std::cerr << simulated << " of " << total << " points simulated ("
+            << failed << " failed), "
+            << grid.Count(GridSweep::INTERPOLATED) << " interpolated"
+            << std::endl;
+
+  if (!csv.empty()) {
+    std::string::size_type slash = csv.rfind('/');
+    if (slash != std::string::npos) {
+      SweepMakeDirs(csv.substr(0, slash));
+    }
+    if (!grid.WriteCsv(csv)) {
+      std::cerr << "Cannot write " << csv << std::endl;
+      return 1;
+    }
+  }
+  if (!binary.empty()) {
+    std::string::size_type slash = binary.rfind('/');
+    if (slash != std::string::npos) {
+      SweepMakeDirs(binary.substr(0, slash));
+    }
+    if (!grid.WriteBinary(binary)) {
+      std::cerr << "Cannot write " << binary << std::endl;
+      return 1;
+    }
+  }
+  return failed == 0 ? 0 : 2;
+}
@@ -0,0 +1,287 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/antenna-module.h"
+#include "ns3/core-module.h"
+#include "ns3/lte-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-loss-model.h"
+#include "sweep-pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * Downlink SINR map (REM) of the lab4 cell for several eNB antenna types,
+ * computed in parallel instead of through RadioEnvironmentMapHelper, e.g.
+ *
+ *   build/scratch/lab4-rem --x=-5000:5000 --y=-5000:5000 --step=5 \
+ *     --output=results/lab4-rem/rem.bin
+ *
+ * The cell is the one lab4-scenario builds: eNB at (0, 0, --enbHeight),
+ * DL EARFCN 100 with 50 RBs, TwoRayGround path loss at the carrier
+ * frequency, the LteEnbPhy::TxPower spread evenly over the RBs and a UE
+ * with LteUePhy::NoiseFigure and an isotropic antenna. Both defaults, like
+ * the antenna attributes, can be changed with --ns3::Type::Attribute=value.
+ * There is a single cell, so the SINR is the signal-to-noise ratio, the
+ * same for every RB.
+ *
+ * Rows of the grid are handed out to --threads workers. Each worker has its
+ * own loss model, mobility models and antennas, created here before the
+ * workers start, since ns-3 objects are not safe to share between threads;
+ * nothing else of ns-3 is touched by them.
+ *
+ * --output is created at its final size and mmap()ed, and the workers write
+ * their rows straight into it, so grids larger than memory work too. It
+ * starts with a little-endian header:
+ *
+ *   char[4] "REM1", uint32 nx, ny, layers, data offset,
+ *   4 bytes padding, double x0, y0, step, z,
+ *   one NUL-terminated antenna type name per layer,
+ *
+ * and at the data offset (a multiple of 64) holds layers * ny * nx float32
+ * SINR values [dB], x fastest, one layer per --antennaTypes entry.
+ */
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("LAB4REM");
+
+namespace {
+
+/* Parse "min:max" (or a single value). */
+bool ParseRange(const std::string &s, double &lo, double &hi) {
+  std::vector<std::string> parts = SweepSplit(s, ':');
+  if (parts.empty() || parts.size() > 2) {
+    return false;
+  }
+  char *end = nullptr;
+  lo = strtod(parts[0].c_str(), &end);
+  if (*end != '\0') {
+    return false;
+  }
+  hi = lo;
+  if (parts.size() == 2) {
+    hi = strtod(parts[1].c_str(), &end);
+    if (*end != '\0') {
+      return false;
+    }
+  }
+  return hi >= lo;
+}
+
+/* Current default of a DoubleValue attribute, including --ns3:: overrides. */
+double DefaultDouble(TypeId tid, const std::string &name) {
+  TypeId::AttributeInformation info;
+  NS_ABORT_MSG_UNLESS(tid.LookupAttributeByName(name, &info),
+                      tid.GetName() << " has no attribute " << name);
+  Ptr<const DoubleValue> value =
+      DynamicCast<const DoubleValue>(info.initialValue);
+  NS_ABORT_MSG_UNLESS(value, tid.GetName() << "::" << name
+                                           << " is not a double");
+  return value->Get();
+}
+
+/* Everything one worker thread evaluates points with. */
+struct Evaluator {
+  Ptr<ConstantPositionMobilityModel> enb;
+  Ptr<ConstantPositionMobilityModel> ue;
+  Ptr<PropagationLossModel> loss;
+  std::vector<Ptr<AntennaModel>> antennas;
+};
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string xRange("-5000:5000");
+  std::string yRange("-5000:5000");
+  double step = 10;
+  double z = 1;
+  double enbHeight = 30;
+  std::string antennaTypes(
+      "IsotropicAntennaModel,ParabolicAntennaModel,CosineAntennaModel");
+  uint32_t earfcn = 100;
+  uint32_t rbs = 50;
+  std::string output("results/lab4-rem/rem.bin");
+  std::string csv;
+  uint32_t threads = 0;
+
+  CommandLine cmd;
+  cmd.AddValue("x", "UE x range \"min:max\" [m]", xRange);
+  cmd.AddValue("y", "UE y range \"min:max\" [m]", yRange);
+  cmd.AddValue("step", "Grid spacing [m]", step);
+  cmd.AddValue("z", "UE height [m]", z);
+  cmd.AddValue("enbHeight", "eNB mast height [m]", enbHeight);
+  cmd.AddValue("antennaTypes", "Comma-separated eNB antenna models, one "
+                               "layer each",
+               antennaTypes);
+  cmd.AddValue("earfcn", "DL EARFCN", earfcn);
+  cmd.AddValue("rbs", "DL bandwidth [RBs]", rbs);
+  cmd.AddValue("output", "Binary SINR grid (see the file comment)", output);
+  cmd.AddValue("csv", "Also write \"x,y,antenna,sinr_db\" lines here (for "
+                      "small grids)",
+               csv);
+  cmd.AddValue("threads", "Worker threads, 0 = one per online CPU", threads);
+  cmd.Parse(argc, argv);
+
+  double xMin, xMax, yMin, yMax;
+  if (!ParseRange(xRange, xMin, xMax) || !ParseRange(yRange, yMin, yMax) ||
+      !(step > 0)) {
+    std::cerr << "--x and --y take \"min:max\" with min <= max, --step > 0"
+              << std::endl;
+    return 1;
+  }
+  std::vector<std::string> types = SweepSplit(antennaTypes, ',');
+  if (types.empty() || output.empty()) {
+    std::cerr << "Need --antennaTypes and --output" << std::endl;
+    return 1;
+  }
+  uint64_t nx = uint64_t(std::floor((xMax - xMin) / step + 1e-9)) + 1;
+  uint64_t ny = uint64_t(std::floor((yMax - yMin) / step + 1e-9)) + 1;
+  uint64_t points = nx * ny;
+
+  double frequency = LteSpectrumValueHelper::GetCarrierFrequency(earfcn);
+  double txDbm = DefaultDouble(LteEnbPhy::GetTypeId(), "TxPower");
+  double noiseFigure = DefaultDouble(LteUePhy::GetTypeId(), "NoiseFigure");
+  // Thermal noise over the RBs, as in
+  // LteSpectrumValueHelper::CreateNoisePowerSpectralDensity
+  double noiseDbm = -174 + noiseFigure + 10 * std::log10(rbs * 180e3);
+
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = std::min<uint64_t>(threads, ny);
+
+  std::vector<Evaluator> evaluators(threads);
+  for (uint32_t t = 0; t < threads; t++) {
+    Evaluator &e = evaluators[t];
+    e.enb = CreateObject<ConstantPositionMobilityModel>();
+    e.enb->SetPosition(Vector(0, 0, enbHeight));
+    e.ue = CreateObject<ConstantPositionMobilityModel>();
+    e.loss = CreateObject<TwoRayGroundPropagationLossModel>();
+    e.loss->SetAttribute("Frequency", DoubleValue(frequency));
+    for (size_t l = 0; l < types.size(); l++) {
+      ObjectFactory factory;
+      factory.SetTypeId("ns3::" + types[l]);
+      e.antennas.push_back(factory.Create<AntennaModel>());
+    }
+  }
+
+  // Header, then the grid at a 64-byte boundary.
+  std::vector<char> header(56);
+  uint32_t dims[4] = {uint32_t(nx), uint32_t(ny), uint32_t(types.size()), 0};
+  double origin[4] = {xMin, yMin, step, z};
+  memcpy(&header[0], "REM1", 4);
+  for (size_t l = 0; l < types.size(); l++) {
+    header.insert(header.end(), types[l].begin(), types[l].end());
+    header.push_back('\0');
+  }
+  dims[3] = (header.size() + 63) / 64 * 64;
+  memcpy(&header[4], dims, sizeof(dims));
+  memcpy(&header[24], origin, sizeof(origin));
+  size_t bytes = dims[3] + points * types.size() * sizeof(float);
+
+  std::string::size_type slash = output.rfind('/');
+  if (slash != std::string::npos) {
+    SweepMakeDirs(output.substr(0, slash));
+  }
+  int fd = open(output.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate(fd, bytes) != 0) {
+    std::cerr << output << ": " << strerror(errno) << std::endl;
+    return 1;
+  }
+  void *map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    std::cerr << output << ": " << strerror(errno) << std::endl;
+    return 1;
+  }
+  char *base = static_cast<char *>(map);
+  memcpy(base, header.data(), header.size());
+  float *grid = reinterpret_cast<float *>(base + dims[3]);
+
+  std::cerr << "REM " << nx << " x " << ny << " x " << types.size()
+            << " at " << frequency / 1e6 << " MHz, " << txDbm
+            << " dBm, noise " << noiseDbm << " dBm, " << threads
+            << " threads" << std::endl;
+
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  std::atomic<uint64_t> nextRow(0);
+  std::vector<std::thread> workers;
+  for (uint32_t t = 0; t < threads; t++) {
+    workers.push_back(std::thread([&, t]() {
+      Evaluator &e = evaluators[t];
+      Vector enbPosition = e.enb->GetPosition();
+      for (uint64_t j; (j = nextRow++) < ny;) {
+        for (uint64_t i = 0; i < nx; i++) {
+          Vector p(xMin + i * step, yMin + j * step, z);
+          e.ue->SetPosition(p);
+          double rxDbm = e.loss->CalcRxPower(txDbm, e.enb, e.ue);
+          Angles angles(p, enbPosition);
+          for (size_t l = 0; l < e.antennas.size(); l++) {
+            grid[(l * ny + j) * nx + i] =
+                rxDbm + e.antennas[l]->GetGainDb(angles) - noiseDbm;
+          }
+        }
+      }
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); t++) {
+    workers[t].join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cerr << points * types.size() << " values in " << elapsed.count()
+            << " s" << std::endl;
+
+  for (size_t l = 0; l < types.size(); l++) {
+    const float *layer = grid + l * points;
+    std::pair<const float *, const float *> range =
+        std::minmax_element(layer, layer + points);
+    std::cerr << types[l] << ": SINR " << *range.first << " to "
+              << *range.second << " dB" << std::endl;
+  }
+
+  if (!csv.empty()) {
+    std::ofstream out(csv.c_str());
+    out << "x,y,antenna,sinr_db\n";
+    for (size_t l = 0; l < types.size(); l++) {
+      for (uint64_t j = 0; j < ny; j++) {
+        for (uint64_t i = 0; i < nx; i++) {
+          out << xMin + i * step << "," << yMin + j * step << "," << types[l]
+              << "," << grid[(l * ny + j) * nx + i] << "\n";
+        }
+      }
+    }
+  }
+
+  int status = msync(map, bytes, MS_SYNC) == 0 ? 0 : 1;
+  munmap(map, bytes);
+  return status;
+}
@@ -28,21 +28,106 @@
 #include "ns3/network-module.h"
 #include "ns3/point-to-point-helper.h"
 #include "ns3/propagation-loss-model.h"
+#include "async-pcap.h"
+#include "caching-spectrum-channel.h"
+#include "convergence-monitor.h"
+#include "counting-sink.h"
+#include "profiling-scheduler.h"
+#include "run-record.h"
+#include "trace-fingerprint.h"
+#include "trajectory-stats.h"
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
 
 using namespace ns3;
 
 /*
  * Instantiates one eNodeB which attaches one UE, and a remote host starts a
- * downlink flow for UE.
+ * downlink flow for UE. With --compareAntennas there is one such pair per
+ * antenna type, and the statistics are split per pair afterwards.
  */
 NS_LOG_COMPONENT_DEFINE("LAB4");
 
+namespace {
+
+/* "ParabolicAntennaModel" -> "parabolic", the directory the scripts use. */
+std::string AntennaLabel(const std::string &type) {
+  std::string label = type.substr(0, type.find("AntennaModel"));
+  for (size_t i = 0; i < label.size(); i++) {
+    label[i] = tolower(label[i]);
+  }
+  return label;
+}
+
+/*
+ * Copy every line of the statistics file `dir`/`name` whose column
+ * `cellColumn` holds a cell id of `dirs` to `dirs[cellId]`/`name`, and the
+ * "%" header line to all of them, so that each pair ends up with the file a
+ * run of its own writes.
+ */
+void SplitByCell(const std::string &dir, const std::string &name,
+                 size_t cellColumn,
+                 const std::map<uint16_t, std::string> &dirs) {
+  std::ifstream in(dir.empty() ? name : dir + "/" + name);
+  if (!in) {
+    return;
+  }
+  std::map<uint16_t, std::unique_ptr<std::ofstream>> out;
+  for (std::map<uint16_t, std::string>::const_iterator d = dirs.begin();
+       d != dirs.end(); d++) {
+    SystemPath::MakeDirectories(d->second);
+    out[d->first].reset(new std::ofstream(d->second + "/" + name));
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    if (!line.empty() && line[0] == '%') {
+      for (std::map<uint16_t, std::unique_ptr<std::ofstream>>::iterator o =
+               out.begin();
+           o != out.end(); o++) {
+        *o->second << line << "\n";
+      }
+      continue;
+    }
+    std::istringstream fields(line);
+    std::string field;
+    for (size_t c = 0; c <= cellColumn; c++) {
+      fields >> field;
+    }
+    uint32_t cellId = std::strtoul(field.c_str(), nullptr, 10);
+    std::map<uint16_t, std::unique_ptr<std::ofstream>>::iterator o =
+        out.find(cellId);
+    if (o != out.end()) {
+      *o->second << line << "\n";
+    }
+  }
+}
+
+} // namespace
+
 int main(int argc, char *argv[]) {
+  WallTimer wall;
   double simTime = 20;
   double appDataRate = 50;
   std::string outputPath = "";
   std::string antennaType = "ParabolicAntennaModel";
   int x, y, z = 0;
+  PcapOptions pcapOptions;
+  double converge = 0;
+  double convergeInterval = 0.1;
+  std::string profile;
+  std::string output;
+  bool fingerprint = false;
+  std::string fingerprintWindows;
+  bool linkCache = false;
+  bool compareAntennas = false;
+  std::string trajectory;
+  double trajectoryStart = 1;
+  double binWidth = 100;
 
   CommandLine cmd;
 
@@ -57,9 +142,51 @@ int main(int argc, char *argv[]) {
                "https://www.nsnam.org/docs/models/html/"
                "antenna-design.html#provided-models",
                antennaType);
+  pcapOptions.AddValues(cmd);
+  cmd.AddValue("converge",
+               "Stop early once the 95% CI of the UE goodput is within this "
+               "fraction of its mean, 0 = always simulate simTime",
+               converge);
+  cmd.AddValue("convergeInterval", "Goodput sampling interval [s]",
+               convergeInterval);
+  cmd.AddValue("profile",
+               "Write wall time per event type and per simulated second to "
+               "this file (\"-\" = stdout)",
+               profile);
+  cmd.AddValue("fingerprint",
+               "Add a hash of all PHY, drop and receive events to the record",
+               fingerprint);
+  cmd.AddValue("fingerprintWindows",
+               "Also write one hash per simulated second to this file",
+               fingerprintWindows);
+  cmd.AddValue("linkCache",
+               "Reuse the received PSD of every link until its transmit PSD "
+               "changes or a node moves",
+               linkCache);
+  cmd.AddValue("compareAntennas",
+               "Simulate one eNB/UE pair per antenna type (isotropic, "
+               "parabolic, cosine) and split the statistics into one "
+               "directory per type under outputPath; antennaType is ignored",
+               compareAntennas);
+  cmd.AddValue("trajectory",
+               "Move the UE from (x, y, z) to this \"x:y:z\" in a straight "
+               "line, from trajectoryStart until simTime, and write "
+               "Trajectory.txt with the statistics per distance bin",
+               trajectory);
+  cmd.AddValue("trajectoryStart",
+               "When the UE starts moving (after attach) [s]",
+               trajectoryStart);
+  cmd.AddValue("binWidth", "Length of the trajectory bins [m]", binWidth);
+  cmd.AddValue("output", "File the run record is appended to (with --converge "
+                         "or --fingerprint and no file it goes to stdout)",
+               output);
 
   cmd.Parse(argc, argv);
 
+  if (!profile.empty()) {
+    ProfilingScheduler::Enable(profile);
+  }
+
   // Define the path for the generated trace files.
   if (outputPath != "") {
     Config::SetDefault("ns3::RadioBearerStatsCalculator::DlRlcOutputFilename",
@@ -82,6 +209,19 @@ int main(int argc, char *argv[]) {
   // Parse again so you can override default values from the command line.
   cmd.Parse(argc, argv);
 
+  // The loss cache only sees course changes, not the constant-velocity
+  // motion in between.
+  NS_ABORT_MSG_IF(linkCache && !trajectory.empty(),
+                  "--linkCache needs static nodes");
+  NS_ABORT_MSG_IF(!(binWidth > 0), "--binWidth must be positive");
+  Vector trajectoryEnd;
+  if (!trajectory.empty()) {
+    std::istringstream in(trajectory);
+    NS_ABORT_MSG_IF(!(in >> trajectoryEnd), "--trajectory expects x:y:z");
+    NS_ABORT_MSG_IF(trajectoryStart >= simTime,
+                    "trajectoryStart must be before simTime");
+  }
+
   NS_LOG_DEBUG("Configuration: \n"
                << "UE Vector: (" << x << ", " << y << ", " << z << ")\n"
                << "App. data rate: " << appDataRate << " Mbps\n"
@@ -89,6 +229,24 @@ int main(int argc, char *argv[]) {
                << "Output path: " << outputPath << "\n"
                << "Antenna type: " << antennaType);
 
+  // One eNB/UE pair per antenna type. --compareAntennas builds a pair for
+  // each of the three types in one simulation behind the same EPC and remote
+  // host. The pairs share positions, so only the antenna differs, and use
+  // carriers 20 MHz apart (DL EARFCN 100, 300, 500) so that they do not
+  // interfere. LteHelper gives the shared loss model the frequency of the
+  // last carrier (2160 MHz DL), which raises the loss of the others by up to
+  // 0.16 dB on the DL and 0.18 dB on the UL within the ~2.7 km where
+  // TwoRayGround follows Friis; beyond that it ignores the frequency.
+  std::vector<std::string> antennaTypes;
+  if (compareAntennas) {
+    antennaTypes.push_back("IsotropicAntennaModel");
+    antennaTypes.push_back("ParabolicAntennaModel");
+    antennaTypes.push_back("CosineAntennaModel");
+  } else {
+    antennaTypes.push_back(antennaType);
+  }
+  size_t pairs = antennaTypes.size();
+
   // Configure the LTE+EPC system. Don't touch these before you already
   // understand the whole LTE system and ns-3 source codes.
   Ptr<LteHelper> lteHelper = CreateObject<LteHelper>();
@@ -98,15 +256,17 @@ int main(int argc, char *argv[]) {
 
   Config::SetDefault("ns3::LteAmc::AmcModel", EnumValue(LteAmc::PiroEW2010));
 
-  lteHelper->SetEnbAntennaModelType("ns3::" + antennaType);
-
-  lteHelper->SetEnbDeviceAttribute("DlEarfcn", UintegerValue(100));
-  lteHelper->SetEnbDeviceAttribute("UlEarfcn", UintegerValue(100 + 18000));
   lteHelper->SetEnbDeviceAttribute("DlBandwidth", UintegerValue(50));
   lteHelper->SetEnbDeviceAttribute("UlBandwidth", UintegerValue(50));
 
-  lteHelper->SetAttribute("PathlossModel",
-                          StringValue("ns3::TwoRayGroundPropagationLossModel"));
+  lteHelper->SetAttribute(
+      "PathlossModel", StringValue("ns3::TwoRayGroundPropagationLossModel"));
+  // Both channels recompute the received PSD of every transmission to every
+  // receiver although nothing moves; with --linkCache it is kept per link.
+  if (linkCache) {
+    lteHelper->SetAttribute("SpectrumChannelType",
+                            StringValue("ns3::CachingSpectrumChannel"));
+  }
 
   // Define P-Gateway in EPC.
   Ptr<Node> pgw = epcHelper->GetPgwNode();
@@ -136,81 +296,216 @@ int main(int argc, char *argv[]) {
 
   NodeContainer ueNodes;
   NodeContainer enbNodes;
-  enbNodes.Create(1);
-  ueNodes.Create(1); // Default: there is only 1 UE in this example.
+  enbNodes.Create(pairs);
+  ueNodes.Create(pairs); // One UE per eNodeB.
 
   // Install Mobility Model.
   MobilityHelper mobility;
   mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
 
   mobility.Install(enbNodes);
+  if (!trajectory.empty()) {
+    mobility.SetMobilityModel("ns3::WaypointMobilityModel");
+  }
   mobility.Install(ueNodes);
 
   Ptr<MobilityModel> MM;
 
-  // Define the location of eNodeB.
-  MM = enbNodes.Get(0)->GetObject<MobilityModel>();
-  MM->SetPosition(Vector3D(0, 0, 30)); // Mast at 30 meters height
-
-  // Define the location of the first UE.
-  MM = ueNodes.Get(0)->GetObject<MobilityModel>();
-  MM->SetPosition(Vector3D(x, y, z)); // Distance between UE and eNodeB.
+  for (size_t i = 0; i < pairs; i++) {
+    // Define the location of eNodeB.
+    MM = enbNodes.Get(i)->GetObject<MobilityModel>();
+    MM->SetPosition(Vector3D(0, 0, 30)); // Mast at 30 meters height
+
+    // Define the location of the UE.
+    if (trajectory.empty()) {
+      MM = ueNodes.Get(i)->GetObject<MobilityModel>();
+      MM->SetPosition(Vector3D(x, y, z)); // Distance between UE and eNodeB.
+    } else {
+      // Wait at (x, y, z) until attached, then head for the end point.
+      Ptr<WaypointMobilityModel> waypoints =
+          ueNodes.Get(i)->GetObject<WaypointMobilityModel>();
+      waypoints->AddWaypoint(Waypoint(Seconds(0), Vector(x, y, z)));
+      waypoints->AddWaypoint(
+          Waypoint(Seconds(trajectoryStart), Vector(x, y, z)));
+      waypoints->AddWaypoint(Waypoint(Seconds(simTime), trajectoryEnd));
+    }
+  }
 
-  // Install LTE Devices to the nodes.
-  NetDeviceContainer enbLteDevs = lteHelper->InstallEnbDevice(enbNodes);
+  // Install LTE Devices to the nodes, one carrier and antenna per eNodeB.
+  NetDeviceContainer enbLteDevs;
+  for (size_t i = 0; i < pairs; i++) {
+    lteHelper->SetEnbAntennaModelType("ns3::" + antennaTypes[i]);
+    uint32_t dlEarfcn = 100 + 200 * i;
+    lteHelper->SetEnbDeviceAttribute("DlEarfcn", UintegerValue(dlEarfcn));
+    lteHelper->SetEnbDeviceAttribute("UlEarfcn",
+                                     UintegerValue(dlEarfcn + 18000));
+    enbLteDevs.Add(lteHelper->InstallEnbDevice(enbNodes.Get(i)));
+  }
   NetDeviceContainer ueLteDevs = lteHelper->InstallUeDevice(ueNodes);
 
   // Install the IP stack on the UEs.
   internet.Install(ueNodes);
-  Ptr<NetDevice> ueLteDevice = ueLteDevs.Get(0);
   Ipv4InterfaceContainer ueIpIface =
-      epcHelper->AssignUeIpv4Address(NetDeviceContainer(ueLteDevice));
-  // Set the default gateway for the UE.
-  Ptr<Ipv4StaticRouting> ueStaticRouting;
-  ueStaticRouting =
-      ipv4RoutingHelper.GetStaticRouting(ueNodes.Get(0)->GetObject<Ipv4>());
-  ueStaticRouting->SetDefaultRoute(epcHelper->GetUeDefaultGatewayAddress(), 1);
+      epcHelper->AssignUeIpv4Address(ueLteDevs);
 
-  // Attach one UE per eNodeB.
-  lteHelper->Attach(ueLteDevs, enbLteDevs.Get(0));
-
-  // Install and start applications on UE and remote host.
   uint16_t dlPort = 1000;
-  Ptr<Ipv4> ueIpv4;
-  int32_t interface;
-  Ipv4Address ueAddr;
   ApplicationContainer onOffApp;
+  ApplicationContainer sinkApp;
+  for (size_t i = 0; i < pairs; i++) {
+    // Set the default gateway for the UE.
+    Ptr<Ipv4StaticRouting> ueStaticRouting;
+    ueStaticRouting =
+        ipv4RoutingHelper.GetStaticRouting(ueNodes.Get(i)->GetObject<Ipv4>());
+    ueStaticRouting->SetDefaultRoute(epcHelper->GetUeDefaultGatewayAddress(),
+                                     1);
+
+    // Attach one UE per eNodeB.
+    lteHelper->Attach(ueLteDevs.Get(i), enbLteDevs.Get(i));
+
+    // Install and start applications on UE and remote host.
+    Ptr<Ipv4> ueIpv4 = ueNodes.Get(i)->GetObject<Ipv4>();
+    int32_t interface = ueIpv4->GetInterfaceForDevice(ueLteDevs.Get(i));
+    NS_ASSERT(interface >= 0);
+    NS_ASSERT(ueIpv4->GetNAddresses(interface) == 1);
+    Ipv4Address ueAddr = ueIpv4->GetAddress(interface, 0).GetLocal();
+
+    OnOffHelper onOffHelper("ns3::UdpSocketFactory",
+                            InetSocketAddress(ueAddr, dlPort));
+    onOffHelper.SetAttribute(
+        "OnTime", StringValue("ns3::ConstantRandomVariable[Constant=5000]"));
+    onOffHelper.SetAttribute(
+        "OffTime", StringValue("ns3::ConstantRandomVariable[Constant=0]"));
+    onOffHelper.SetAttribute(
+        "DataRate",
+        DataRateValue(DataRate(std::to_string(appDataRate) + "Mbps")));
+    onOffHelper.SetAttribute("PacketSize", UintegerValue(1024));
+    onOffApp.Add(onOffHelper.Install(remoteHost));
+
+    // The monitor and the trajectory bins need a byte count at the UE. Only
+    // install the sink for them so that the default traces stay exactly as
+    // they were.
+    if (converge > 0 || !trajectory.empty()) {
+      CountingSinkHelper sinkHelper("ns3::UdpSocketFactory",
+                                    InetSocketAddress(ueAddr, dlPort));
+      sinkApp.Add(sinkHelper.Install(ueNodes.Get(i)));
+    }
+
+    // LTE QoS bearer
+    EpsBearer bearer(EpsBearer::NGBR_VOICE_VIDEO_GAMING);
+    lteHelper->ActivateDedicatedEpsBearer(ueLteDevs.Get(i), bearer,
+                                          EpcTft::Default());
+  }
+
+  std::vector<std::unique_ptr<TrajectoryStats>> trajectoryStats;
+  for (size_t i = 0; !trajectory.empty() && i < pairs; i++) {
+    trajectoryStats.emplace_back(new TrajectoryStats(
+        ueNodes.Get(i)->GetObject<MobilityModel>(),
+        enbNodes.Get(i)->GetObject<MobilityModel>(), binWidth,
+        Seconds(trajectoryStart)));
+    trajectoryStats[i]->ConnectSink(sinkApp.Get(i));
+    trajectoryStats[i]->ConnectLte(ueLteDevs.Get(i), enbLteDevs.Get(i));
+  }
 
-  ueIpv4 = ueNodes.Get(0)->GetObject<Ipv4>();
-  interface = ueIpv4->GetInterfaceForDevice(
-      ueNodes.Get(0)->GetDevice(0)->GetObject<LteUeNetDevice>());
-  NS_ASSERT(interface >= 0);
-  NS_ASSERT(ueIpv4->GetNAddresses(interface) == 1);
-  ueAddr = ueIpv4->GetAddress(interface, 0).GetLocal();
-
-  OnOffHelper onOffHelper("ns3::UdpSocketFactory",
-                          InetSocketAddress(ueAddr, dlPort));
-  onOffHelper.SetAttribute(
-      "OnTime", StringValue("ns3::ConstantRandomVariable[Constant=5000]"));
-  onOffHelper.SetAttribute(
-      "OffTime", StringValue("ns3::ConstantRandomVariable[Constant=0]"));
-  onOffHelper.SetAttribute(
-      "DataRate",
-      DataRateValue(DataRate(std::to_string(appDataRate) + "Mbps")));
-  onOffHelper.SetAttribute("PacketSize", UintegerValue(1024));
-  onOffApp.Add(onOffHelper.Install(remoteHost));
-
-  // LTE QoS bearer
-  EpsBearer bearer(EpsBearer::NGBR_VOICE_VIDEO_GAMING);
-  lteHelper->ActivateDedicatedEpsBearer(ueLteDevs.Get(0), bearer,
-                                        EpcTft::Default());
+  // With --compareAntennas the monitor follows the goodput of all UEs.
+  ConvergenceMonitor monitor(
+      MakeBoundCallback(&CountingSink::GetRxBytes, sinkApp),
+      Seconds(convergeInterval), converge);
+  if (converge > 0) {
+    monitor.Start();
+  }
 
   lteHelper->EnableTraces();
-  p2ph.EnablePcapAll(outputPath + "/LTE");
+  AsyncPcapHelper asyncPcap(pcapOptions);
+  if (pcapOptions.async) {
+    asyncPcap.EnablePointToPointAll(outputPath + "/LTE");
+  } else {
+    p2ph.EnablePcapAll(outputPath + "/LTE");
+  }
+
+  // The UE only has an application to trace with --converge.
+  bool fingerprinting = fingerprint || !fingerprintWindows.empty();
+  TraceFingerprint traceFingerprint;
+  if (fingerprinting) {
+    traceFingerprint.ConnectLte();
+    traceFingerprint.ConnectPointToPoint();
+    traceFingerprint.ConnectApps(sinkApp);
+  }
 
   Simulator::Stop(Seconds(simTime));
+  double setupSeconds = wall.Seconds();
+  WallTimer sim;
   Simulator::Run();
+  asyncPcap.Close();
+
+  if (!output.empty() || converge > 0 || fingerprinting) {
+    RunRecord record;
+    record.Add("antennaType", compareAntennas ? "compare" : antennaType);
+    // Per-pair values are prefixed with the antenna label when comparing
+    std::vector<std::string> prefixes;
+    for (size_t i = 0; i < pairs; i++) {
+      prefixes.push_back(compareAntennas ? AntennaLabel(antennaTypes[i]) + "."
+                                         : "");
+    }
+    if (linkCache) {
+      Ptr<CachingSpectrumChannel> dl = DynamicCast<CachingSpectrumChannel>(
+          lteHelper->GetDownlinkSpectrumChannel());
+      Ptr<CachingSpectrumChannel> ul = DynamicCast<CachingSpectrumChannel>(
+          lteHelper->GetUplinkSpectrumChannel());
+      record.Add("dl_psd_hits", dl->GetHits());
+      record.Add("dl_psd_misses", dl->GetMisses());
+      record.Add("ul_psd_hits", ul->GetHits());
+      record.Add("ul_psd_misses", ul->GetMisses());
+    }
+    record.Add("setup_s", setupSeconds);
+    record.Add("sim_s", sim.Seconds());
+    record.Add("events", Simulator::GetEventCount());
+    if (converge > 0) {
+      monitor.Record(record);
+      for (size_t i = 0; i < pairs; i++) {
+        CountingSink::Record(ApplicationContainer(sinkApp.Get(i)),
+                             prefixes[i] + "app", record);
+      }
+    }
+    if (fingerprinting) {
+      traceFingerprint.Record(record);
+    }
+    record.Add("wall_s", wall.Seconds());
+    record.Add("rss_kb", PeakRssKb());
+    record.Write(output);
+  }
+  if (!fingerprintWindows.empty()) {
+    traceFingerprint.WriteWindows(fingerprintWindows);
+  }
 
+  std::map<uint16_t, std::string> dirs;
+  for (size_t i = 0; compareAntennas && i < pairs; i++) {
+    Ptr<LteEnbNetDevice> enb = enbLteDevs.Get(i)->GetObject<LteEnbNetDevice>();
+    dirs[enb->GetCellId()] = (outputPath.empty() ? "" : outputPath + "/") +
+                             AntennaLabel(antennaTypes[i]);
+  }
+  for (size_t i = 0; i < trajectoryStats.size(); i++) {
+    std::string dir = outputPath;
+    if (compareAntennas) {
+      dir += (dir.empty() ? "" : "/") + AntennaLabel(antennaTypes[i]);
+      SystemPath::MakeDirectories(dir);
+    }
+    trajectoryStats[i]->Write((dir.empty() ? "" : dir + "/") +
+                              "Trajectory.txt");
+  }
   Simulator::Destroy();
+  // The RLC/PDCP calculators write their last epoch when they are disposed,
+  // so drop them before their files are split.
+  lteHelper = 0;
+
+  if (compareAntennas) {
+    // Column of the cell id: "start end CellId ..." for RLC and PDCP,
+    // "time cellId ..." for MAC.
+    SplitByCell(outputPath, "DlRlcStats.txt", 2, dirs);
+    SplitByCell(outputPath, "UlRlcStats.txt", 2, dirs);
+    SplitByCell(outputPath, "DlPdcpStats.txt", 2, dirs);
+    SplitByCell(outputPath, "UlPdcpStats.txt", 2, dirs);
+    SplitByCell(outputPath, "DlMacStats.txt", 1, dirs);
+    SplitByCell(outputPath, "UlMacStats.txt", 1, dirs);
+  }
   return 0;
 }
@@ -0,0 +1,416 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <glob.h>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * Summarises the pcaps written by the scenarios, e.g.
+ *
+ *   build/scratch/pcap-analyzer \
+ *     --inputs="results/nSta-*-pktSize-*-node*.pcap" --duration=100
+ *
+ * Every capture is mmap()ed and walked record by record without copying.
+ * 802.11 (with or without radiotap), PPP, Ethernet and raw IP link types are
+ * understood down to the IPv4/UDP/TCP headers. Per file it reports the
+ * MAC-level throughput of all frames, the application throughput of UDP/TCP
+ * payload, and per-flow bytes, packets and 802.11 retries. With --bin it also
+ * writes time-binned throughput.
+ *
+ * Files are spread over worker threads. Pages already parsed are dropped with
+ * MADV_DONTNEED, so the resident size stays bounded even on multi-GB
+ * captures.
+ */
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("PCAP_ANALYZER");
+
+namespace {
+
+const uint32_t LINKTYPE_ETHERNET = 1;
+const uint32_t LINKTYPE_PPP = 9;
+const uint32_t LINKTYPE_RAW = 101;
+const uint32_t LINKTYPE_IEEE802_11 = 105;
+const uint32_t LINKTYPE_IEEE802_11_RADIOTAP = 127;
+
+// Parsed pages are released in windows of this size.
+const size_t RELEASE_WINDOW = 64 << 20;
+
+struct FlowKey {
+  uint32_t src, dst;
+  uint16_t sport, dport;
+  uint8_t proto;
+
+  bool operator<(const FlowKey &o) const {
+    if (src != o.src) return src < o.src;
+    if (dst != o.dst) return dst < o.dst;
+    if (sport != o.sport) return sport < o.sport;
+    if (dport != o.dport) return dport < o.dport;
+    return proto < o.proto;
+  }
+};
+
+struct FlowCounters {
+  uint64_t packets = 0;
+  uint64_t bytes = 0;   // Captured frame length (original length on the wire)
+  uint64_t payload = 0; // Transport payload of frames that are not retries
+  uint64_t retries = 0;
+  double first = -1, last = 0;
+};
+
+struct FileResult {
+  std::string path;
+  std::string error;
+  uint32_t linkType = 0;
+  uint64_t frames = 0;
+  uint64_t bytes = 0;
+  uint64_t payload = 0;
+  uint64_t retries = 0;
+  double first = -1, last = 0;
+  std::map<FlowKey, FlowCounters> flows;
+  std::vector<uint64_t> binBytes;
+  std::vector<uint64_t> binPayload;
+};
+
+inline uint16_t Be16(const uint8_t *p) { return uint16_t(p[0] << 8 | p[1]); }
+inline uint32_t Be32(const uint8_t *p) {
+  return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+}
+inline uint16_t Le16(const uint8_t *p) { return uint16_t(p[1] << 8 | p[0]); }
+
+inline uint32_t Read32(const uint8_t *p, bool swap) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return swap ? __builtin_bswap32(v) : v;
+}
+
+std::string Ip(uint32_t a) {
+  std::ostringstream os;
+  os << (a >> 24) << "." << (a >> 16 & 0xff) << "." << (a >> 8 & 0xff) << "."
+     << (a & 0xff);
+  return os.str();
+}
+
+/* Offset of the IPv4 header in a frame, or -1 if it does not carry IPv4.
+ * `retry` is set from the 802.11 frame control field. */
+long LocateIpv4(uint32_t linkType, const uint8_t *f, uint32_t len, bool &retry) {
+  retry = false;
+  uint32_t off = 0;
+  switch (linkType) {
+  case LINKTYPE_RAW:
+    return len >= 20 ? 0 : -1;
+  case LINKTYPE_ETHERNET:
+    return len >= 34 && Be16(f + 12) == 0x0800 ? 14 : -1;
+  case LINKTYPE_PPP:
+    // ns-3 writes only the two-byte protocol field; real captures may carry
+    // the HDLC address/control bytes in front of it.
+    if (len >= 2 && f[0] == 0xff && f[1] == 0x03) {
+      off = 2;
+    }
+    return len >= off + 22 && Be16(f + off) == 0x0021 ? off + 2 : -1;
+  case LINKTYPE_IEEE802_11_RADIOTAP:
+    if (len < 4) {
+      return -1;
+    }
+    // Skip the radiotap header and parse the 802.11 frame behind it.
+    off = Le16(f + 2);
+    // Fall through.
+  case LINKTYPE_IEEE802_11: {
+    if (len < off + 24) {
+      return -1;
+    }
+    uint8_t fc0 = f[off], fc1 = f[off + 1];
+    retry = fc1 & 0x08;
+    if ((fc0 >> 2 & 0x3) != 2 || (fc1 & 0x40)) {
+      return -1; // Not a data frame, or encrypted
+    }
+    uint32_t hdr = 24;
+    if ((fc1 & 0x03) == 0x03) {
+      hdr += 6; // Four-address frame
+    }
+    if (fc0 & 0x80) {
+      hdr += 2; // QoS control
+    }
+    const uint8_t *llc = f + off + hdr;
+    if (len < off + hdr + 8 + 20 || llc[0] != 0xaa || llc[1] != 0xaa ||
+        Be16(llc + 6) != 0x0800) {
+      return -1;
+    }
+    return off + hdr + 8;
+  }
+  default:
+    return -1;
+  }
+}
+
+void Analyze(const std::string &path, double binWidth, FileResult &r) {
+  r.path = path;
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    r.error = strerror(errno);
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size < 24) {
+    r.error = "not a pcap file";
+    close(fd);
+    return;
+  }
+  size_t size = st.st_size;
+  void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    r.error = strerror(errno);
+    return;
+  }
+  madvise(map, size, MADV_SEQUENTIAL);
+  const uint8_t *base = static_cast<const uint8_t *>(map);
+
+  uint32_t magic;
+  memcpy(&magic, base, 4);
+  bool swap, nano;
+  if (magic == 0xa1b2c3d4 || magic == 0xa1b23c4d) {
+    swap = false;
+  } else if (magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1) {
+    swap = true;
+  } else {
+    r.error = "not a pcap file";
+    munmap(map, size);
+    return;
+  }
+  nano = magic == 0xa1b23c4d || magic == 0x4d3cb2a1;
+  r.linkType = Read32(base + 20, swap);
+
+  size_t pos = 24, released = 0;
+  while (pos + 16 <= size) {
+    uint32_t sec = Read32(base + pos, swap);
+    uint32_t frac = Read32(base + pos + 4, swap);
+    uint32_t caplen = Read32(base + pos + 8, swap);
+    uint32_t origlen = Read32(base + pos + 12, swap);
+    const uint8_t *frame = base + pos + 16;
+    pos += 16 + size_t(caplen);
+    if (pos > size) {
+      break; // Truncated last record
+    }
+
+    double t = sec + frac * (nano ? 1e-9 : 1e-6);
+    if (r.first < 0) {
+      r.first = t;
+    }
+    r.last = t;
+    r.frames++;
+    r.bytes += origlen;
+
+    bool retry;
+    uint64_t payload = 0;
+    long ip = LocateIpv4(r.linkType, frame, caplen, retry);
+    r.retries += retry;
+    if (ip >= 0 && (frame[ip] >> 4) == 4) {
+      const uint8_t *h = frame + ip;
+      uint32_t ihl = (h[0] & 0x0f) * 4;
+      uint32_t total = Be16(h + 2);
+      bool firstFragment = (Be16(h + 6) & 0x1fff) == 0;
+      FlowKey key;
+      key.src = Be32(h + 12);
+      key.dst = Be32(h + 16);
+      key.proto = h[9];
+      key.sport = key.dport = 0;
+      uint32_t l4 = 0;
+      if (firstFragment && caplen >= ip + ihl + 4 &&
+          (key.proto == 17 || key.proto == 6)) {
+        key.sport = Be16(h + ihl);
+        key.dport = Be16(h + ihl + 2);
+        if (key.proto == 17) {
+          l4 = 8;
+        } else if (caplen >= ip + ihl + 13) {
+          l4 = (h[ihl + 12] >> 4) * 4;
+        }
+      }
+      if (l4 && total > ihl + l4 && !retry) {
+        payload = total - ihl - l4;
+      }
+      FlowCounters &c = r.flows[key];
+      if (c.first < 0) {
+        c.first = t;
+      }
+      c.last = t;
+      c.packets++;
+      c.bytes += origlen;
+      c.payload += payload;
+      c.retries += retry;
+      r.payload += payload;
+    }
+
+    if (binWidth > 0) {
+      size_t bin = size_t((t - r.first) / binWidth);
+      if (bin >= r.binBytes.size()) {
+        r.binBytes.resize(bin + 1, 0);
+        r.binPayload.resize(bin + 1, 0);
+      }
+      r.binBytes[bin] += origlen;
+      r.binPayload[bin] += payload;
+    }
+
+    // Give back what we have parsed so far; the page cache keeps it cheap to
+    // reread but it no longer counts against our resident set.
+    if (pos - released >= 2 * RELEASE_WINDOW) {
+      size_t upto = (pos - RELEASE_WINDOW) & ~size_t(getpagesize() - 1);
+      madvise(const_cast<uint8_t *>(base) + released, upto - released,
+              MADV_DONTNEED);
+      released = upto;
+    }
+  }
+  munmap(map, size);
+}
+
+std::vector<std::string> Expand(const std::string &patterns) {
+  std::vector<std::string> files;
+  std::istringstream is(patterns);
+  std::string pattern;
+  while (std::getline(is, pattern, ',')) {
+    if (pattern.empty()) {
+      continue;
+    }
+    glob_t g;
+    if (glob(pattern.c_str(), 0, nullptr, &g) == 0) {
+      for (size_t i = 0; i < g.gl_pathc; i++) {
+        files.push_back(g.gl_pathv[i]);
+      }
+    } else {
+      files.push_back(pattern); // Reported as unreadable later
+    }
+    globfree(&g);
+  }
+  return files;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string inputs;
+  std::string flowsPath;
+  std::string binsPath;
+  double duration = 0;
+  double bin = 0;
+  uint32_t threads = 0;
+
+  CommandLine cmd;
+  cmd.AddValue("inputs", "Comma-separated pcap files or glob patterns", inputs);
+  cmd.AddValue("duration",
+               "Measurement duration [s], default first to last frame",
+               duration);
+  cmd.AddValue("bin", "Width of the throughput time bins [s], 0 = off", bin);
+  cmd.AddValue("flows", "CSV file for the per-flow table", flowsPath);
+  cmd.AddValue("bins", "CSV file for the time-binned throughput", binsPath);
+  cmd.AddValue("threads", "Worker threads, 0 = one per online CPU", threads);
+  cmd.Parse(argc, argv);
+
+  std::vector<std::string> files = Expand(inputs);
+  if (files.empty()) {
+    std::cerr << "No input files, see --inputs" << std::endl;
+    return 1;
+  }
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = std::min<size_t>(threads, files.size());
+
+  std::vector<FileResult> results(files.size());
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for (uint32_t i = 0; i < threads; i++) {
+    workers.push_back(std::thread([&]() {
+      for (size_t f; (f = next++) < files.size();) {
+        Analyze(files[f], bin, results[f]);
+      }
+    }));
+  }
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+
+  // Same layout as the tables in measurements/.
+  std::cout << "| File | Frames | Retries | Total throughput (Mbps) | "
+               "Application (Mbps) |\n"
+            << "|------|--------|---------|-------------------------|"
+               "--------------------|\n";
+  int status = 0;
+  for (size_t i = 0; i < results.size(); i++) {
+    const FileResult &r = results[i];
+    if (!r.error.empty()) {
+      std::cerr << r.path << ": " << r.error << std::endl;
+      status = 1;
+      continue;
+    }
+    double seconds = duration > 0 ? duration : r.last - r.first;
+    double scale = seconds > 0 ? 8 / seconds / 1e6 : 0;
+    std::cout << "| " << r.path << " | " << r.frames << " | " << r.retries
+              << " | " << std::fixed << std::setprecision(3) << r.bytes * scale
+              << " | " << r.payload * scale << " |\n";
+    std::cout.unsetf(std::ios::floatfield);
+  }
+
+  if (!flowsPath.empty()) {
+    std::ofstream out(flowsPath.c_str());
+    out << "file,src,sport,dst,dport,proto,packets,bytes,payload,retries,"
+           "first_s,last_s,goodput_mbps\n";
+    for (size_t i = 0; i < results.size(); i++) {
+      const FileResult &r = results[i];
+      double seconds = duration > 0 ? duration : r.last - r.first;
+      for (std::map<FlowKey, FlowCounters>::const_iterator f = r.flows.begin();
+           f != r.flows.end(); f++) {
+        const FlowCounters &c = f->second;
+        out << r.path << "," << Ip(f->first.src) << "," << f->first.sport << ","
+            << Ip(f->first.dst) << "," << f->first.dport << ","
+            << unsigned(f->first.proto) << "," << c.packets << "," << c.bytes
+            << "," << c.payload << "," << c.retries << "," << c.first << ","
+            << c.last << ","
+            << (seconds > 0 ? c.payload * 8 / seconds / 1e6 : 0) << "\n";
+      }
+    }
+  }
+
+  if (!binsPath.empty() && bin > 0) {
+    std::ofstream out(binsPath.c_str());
+    out << "file,start_s,total_mbps,application_mbps\n";
+    for (size_t i = 0; i < results.size(); i++) {
+      const FileResult &r = results[i];
+      for (size_t b = 0; b < r.binBytes.size(); b++) {
+        out << r.path << "," << r.first + b * bin << ","
+            << r.binBytes[b] * 8 / bin / 1e6 << ","
+            << r.binPayload[b] * 8 / bin / 1e6 << "\n";
+      }
+    }
+  }
+  return status;
+}
@@ -0,0 +1,302 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PROFILING_SCHEDULER_H
+#define PROFILING_SCHEDULER_H
+
+#include "ns3/core-module.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * Scheduler that forwards to a real one ("SchedulerType", MapScheduler by
+ * default) and measures what the simulation spends its time on.
+ *
+ * The simulator takes the next event with RemoveNext(), runs it and then
+ * checks IsEmpty(), so the wall-clock time between those two calls is the
+ * run time of the event. That time and an event count are attributed to the
+ * EventImpl's dynamic type, which for MakeEvent() events names the member
+ * function signature and so the class that owns the callback
+ * (e.g. "void (ns3::Txop::*)(), ns3::Txop*").
+ * Cancelled events are counted under their own row. Events, wall time and
+ * peak queue depth are also binned per simulated second.
+ *
+ * Enable() installs it for the current simulation and prints the report
+ * from Simulator::Destroy, before the remaining events are drained.
+ */
+class ProfilingScheduler : public Scheduler {
+public:
+  static TypeId GetTypeId() {
+    static TypeId tid =
+        TypeId("ns3::ProfilingScheduler")
+            .SetParent<Scheduler>()
+            .SetGroupName("Core")
+            .AddConstructor<ProfilingScheduler>()
+            .AddAttribute(
+                "SchedulerType", "The scheduler that holds the events.",
+                TypeIdValue(MapScheduler::GetTypeId()),
+                MakeTypeIdAccessor(&ProfilingScheduler::SetSchedulerType),
+                MakeTypeIdChecker())
+            .AddAttribute("Output", "Report file, stdout if empty or \"-\".",
+                          StringValue(""),
+                          MakeStringAccessor(&ProfilingScheduler::m_output),
+                          MakeStringChecker());
+    return tid;
+  }
+
+  ProfilingScheduler()
+      : m_size(0), m_peak(0), m_inFlight(-1), m_inFlightSecond(0),
+        m_reported(false) {
+    s_current = this;
+  }
+
+  ~ProfilingScheduler() {
+    if (s_current == this) {
+      s_current = nullptr;
+    }
+  }
+
+  /* Profile the current simulation, reporting to `output` ("-" = stdout). */
+  static void Enable(const std::string &output) {
+    ObjectFactory factory;
+    factory.SetTypeId(GetTypeId());
+    factory.Set("Output", StringValue(output));
+    Simulator::SetScheduler(factory);
+    Simulator::ScheduleDestroy(&ProfilingScheduler::ReportCurrent);
+  }
+
+  virtual void Insert(const Event &ev) {
+    m_inner->Insert(ev);
+    m_peak = std::max(m_peak, ++m_size);
+    if (!m_reported) {
+      Bin &bin = BinAt(m_inFlightSecond);
+      bin.peak = std::max(bin.peak, m_size);
+    }
+  }
+
+  virtual bool IsEmpty() const {
+    // Simulator::Run() asks right after every event, so this is where the
+    // running event ends; later RemoveNext() calls would also charge it with
+    // whatever runs after Run() returns.
+    if (m_inFlight >= 0) {
+      const_cast<ProfilingScheduler *>(this)->CloseInFlight(Clock::now());
+    }
+    return m_inner->IsEmpty();
+  }
+
+  virtual Event PeekNext() const { return m_inner->PeekNext(); }
+
+  virtual Event RemoveNext() {
+    Event ev = m_inner->RemoveNext();
+    m_size--;
+    if (!m_reported) {
+      Clock::time_point now = Clock::now();
+      CloseInFlight(now);
+      m_inFlight = ev.impl->IsCancelled() ? Cancelled() : TypeOf(*ev.impl);
+      m_inFlightSecond = Second(ev.key.m_ts);
+      m_inFlightStart = now;
+    }
+    return ev;
+  }
+
+  virtual void Remove(const Event &ev) {
+    m_inner->Remove(ev);
+    m_size--;
+  }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Row {
+    std::string name;
+    uint64_t events;
+    double seconds;
+  };
+
+  struct Bin {
+    uint64_t events;
+    double seconds;
+    uint64_t peak;
+  };
+
+  static ProfilingScheduler *s_current;
+
+  static void ReportCurrent() {
+    if (s_current != nullptr) {
+      s_current->Report();
+    }
+  }
+
+  void SetSchedulerType(TypeId type) {
+    ObjectFactory factory;
+    factory.SetTypeId(type);
+    m_inner = factory.Create<Scheduler>();
+  }
+
+  static uint64_t Second(uint64_t ts) {
+    return ts / uint64_t(Seconds(1).GetTimeStep());
+  }
+
+  Bin &BinAt(uint64_t second) {
+    if (second >= m_bins.size()) {
+      Bin empty = {0, 0, 0};
+      m_bins.resize(second + 1, empty);
+    }
+    return m_bins[second];
+  }
+
+  /* Charge the time since the previous RemoveNext() to that event. */
+  void CloseInFlight(Clock::time_point now) {
+    if (m_inFlight < 0) {
+      return;
+    }
+    double seconds =
+        std::chrono::duration<double>(now - m_inFlightStart).count();
+    Row &row = m_rows[m_inFlight];
+    row.events++;
+    row.seconds += seconds;
+    Bin &bin = BinAt(m_inFlightSecond);
+    bin.events++;
+    bin.seconds += seconds;
+    m_inFlight = -1;
+  }
+
+  int AddRow(const std::string &name) {
+    Row row = {name, 0, 0};
+    m_rows.push_back(row);
+    return m_rows.size() - 1;
+  }
+
+  int Cancelled() {
+    static const std::type_index key(typeid(void));
+    std::unordered_map<std::type_index, int>::const_iterator it =
+        m_types.find(key);
+    if (it != m_types.end()) {
+      return it->second;
+    }
+    return m_types[key] = AddRow("(cancelled)");
+  }
+
+  int TypeOf(const EventImpl &impl) {
+    std::type_index key(typeid(impl));
+    std::unordered_map<std::type_index, int>::const_iterator it =
+        m_types.find(key);
+    if (it != m_types.end()) {
+      return it->second;
+    }
+    return m_types[key] = AddRow(ShortName(typeid(impl).name()));
+  }
+
+  /* Demangle and keep only the template arguments of MakeEvent<...>. */
+  static std::string ShortName(const char *mangled) {
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+    std::string name = status == 0 ? demangled : mangled;
+    free(demangled);
+    const std::string make = "MakeEvent<";
+    std::string::size_type start = name.find(make);
+    if (start == std::string::npos) {
+      return name;
+    }
+    start += make.size();
+    int depth = 1;
+    for (std::string::size_type i = start; i < name.size(); i++) {
+      depth += name[i] == '<' ? 1 : name[i] == '>' ? -1 : 0;
+      if (depth == 0) {
+        return name.substr(start, i - start);
+      }
+    }
+    return name;
+  }
+
+  void Report() {
+    CloseInFlight(Clock::now());
+    m_reported = true;
+
+    std::vector<Row> rows(m_rows);
+    std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) {
+      return a.seconds > b.seconds;
+    });
+    uint64_t events = 0;
+    double total = 0;
+    for (size_t i = 0; i < rows.size(); i++) {
+      events += rows[i].events;
+      total += rows[i].seconds;
+    }
+
+    bool console = m_output.empty() || m_output == "-";
+    std::ofstream file;
+    if (!console) {
+      file.open(m_output.c_str());
+    }
+    std::ostream &out = console ? std::cout : file;
+    char line[1024];
+    snprintf(line, sizeof(line),
+             "Event profile: %llu events, %.3f s wall, peak queue %llu\n\n",
+             (unsigned long long)events, total, (unsigned long long)m_peak);
+    out << line;
+    out << "| share | wall_ms | events | ns/event | event type |\n";
+    out << "|------:|--------:|-------:|---------:|------------|\n";
+    for (size_t i = 0; i < rows.size(); i++) {
+      snprintf(line, sizeof(line), "| %5.1f%% | %.1f | %llu | %.0f | %s |\n",
+               total > 0 ? 100 * rows[i].seconds / total : 0.0,
+               rows[i].seconds * 1e3, (unsigned long long)rows[i].events,
+               rows[i].events ? rows[i].seconds * 1e9 / rows[i].events : 0.0,
+               rows[i].name.c_str());
+      out << line;
+    }
+    out << "\n| sim_s | events | wall_ms | peak_queue |\n";
+    out << "|------:|-------:|--------:|-----------:|\n";
+    for (size_t s = 0; s < m_bins.size(); s++) {
+      snprintf(line, sizeof(line), "| %zu | %llu | %.1f | %llu |\n", s,
+               (unsigned long long)m_bins[s].events, m_bins[s].seconds * 1e3,
+               (unsigned long long)m_bins[s].peak);
+      out << line;
+    }
+  }
+
+  Ptr<Scheduler> m_inner;
+  std::string m_output;
+  uint64_t m_size; // Events currently queued
+  uint64_t m_peak;
+  std::vector<Row> m_rows;
+  std::unordered_map<std::type_index, int> m_types;
+  std::vector<Bin> m_bins;
+  int m_inFlight; // Row of the event running now, -1 for none
+  uint64_t m_inFlightSecond; // Simulated second of that event
+  Clock::time_point m_inFlightStart;
+  bool m_reported;
+};
+
+ProfilingScheduler *ProfilingScheduler::s_current = nullptr;
+
+NS_OBJECT_ENSURE_REGISTERED(ProfilingScheduler);
+
+} // namespace ns3
+
+#endif /* PROFILING_SCHEDULER_H */
@@ -0,0 +1,157 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Microbenchmark for cached-propagation.h.
+ *
+ * Replays the loss and delay queries YansWifiChannel::Send makes (one sender,
+ * then each of its receivers) on two static topologies:
+ *
+ *  - "lab2": the four STAs and the AP of the lab2 scenarios,
+ *  - "chain": the LAB3adhoc line of --chain nodes at 200 m, where every node
+ *    only reaches the --neighbours nodes on either side (as with
+ *    --spatialChannel; use a large value for the shared channel).
+ *
+ * and prints the time per query with the plain TwoRayGround/ConstantSpeed
+ * models and with the cached wrappers, plus the largest difference between
+ * the two results. End-to-end numbers come from running lab2-scenario1p2 or
+ * LAB3adhoc with and without --propagationCache.
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/propagation-loss-model.h"
+#include "cached-propagation.h"
+#include "run-record.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("PropagationCacheBench");
+
+struct BenchResult {
+  double nsPerQuery;
+  double checksum; // Sum of all rx powers, to compare plain and cached
+};
+
+static BenchResult Replay(const std::vector<Ptr<MobilityModel>> &nodes,
+                          uint32_t neighbours, uint32_t rounds,
+                          Ptr<PropagationLossModel> loss,
+                          Ptr<PropagationDelayModel> delay) {
+  uint64_t queries = 0;
+  double checksum = 0;
+  int64_t delays = 0;
+  WallTimer timer;
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (size_t i = 0; i < nodes.size(); i++) {
+      size_t from = i > neighbours ? i - neighbours : 0;
+      size_t to = std::min(nodes.size(), i + neighbours + 1);
+      for (size_t j = from; j < to; j++) {
+        if (j == i) {
+          continue;
+        }
+        checksum += loss->CalcRxPower(16, nodes[i], nodes[j]);
+        delays += delay->GetDelay(nodes[i], nodes[j]).GetTimeStep();
+        queries++;
+      }
+    }
+  }
+  BenchResult result;
+  result.nsPerQuery = queries ? timer.Seconds() * 1e9 / queries : 0;
+  // Fold the delays in so the compiler cannot drop the calls.
+  result.checksum = checksum + delays * 1e-30;
+  return result;
+}
+
+static void Bench(const char *name,
+                  const std::vector<Ptr<MobilityModel>> &nodes,
+                  uint32_t neighbours, uint32_t rounds) {
+  Ptr<TwoRayGroundPropagationLossModel> loss =
+      CreateObject<TwoRayGroundPropagationLossModel>();
+  Ptr<ConstantSpeedPropagationDelayModel> delay =
+      CreateObject<ConstantSpeedPropagationDelayModel>();
+  BenchResult plain = Replay(nodes, neighbours, rounds, loss, delay);
+
+  Ptr<CachedPropagationLossModel> cachedLoss =
+      CreateObject<CachedPropagationLossModel>();
+  cachedLoss->SetModel(loss);
+  Ptr<CachedPropagationDelayModel> cachedDelay =
+      CreateObject<CachedPropagationDelayModel>();
+  cachedDelay->SetModel(delay);
+  BenchResult cached =
+      Replay(nodes, neighbours, rounds, cachedLoss, cachedDelay);
+
+  printf("| %-5s | %6zu | %10.1f | %10.1f | %7.2fx | %9.2e | %9.1f |\n", name,
+         nodes.size(), plain.nsPerQuery, cached.nsPerQuery,
+         cached.nsPerQuery > 0 ? plain.nsPerQuery / cached.nsPerQuery : 0.0,
+         std::fabs(plain.checksum - cached.checksum),
+         100.0 * cachedLoss->GetHits() /
+             std::max<uint64_t>(1, cachedLoss->GetHits() +
+                                       cachedLoss->GetMisses()));
+  fflush(stdout);
+
+  cachedLoss->Dispose();
+  cachedDelay->Dispose();
+}
+
+static Ptr<MobilityModel> At(double x, double y, double z) {
+  Ptr<ConstantPositionMobilityModel> m =
+      CreateObject<ConstantPositionMobilityModel>();
+  m->SetPosition(Vector(x, y, z));
+  return m;
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t chain = 10000;
+  uint32_t neighbours = 3;
+  uint32_t queries = 10000000;
+
+  CommandLine cmd;
+  cmd.AddValue("chain", "Nodes in the LAB3 chain", chain);
+  cmd.AddValue("neighbours", "Receivers on either side of each chain node",
+               neighbours);
+  cmd.AddValue("queries", "Approximate queries per topology and model",
+               queries);
+  cmd.Parse(argc, argv);
+
+  printf("| topo  | nodes  | plain_ns   | cached_ns  | speedup  | max_diff  "
+         "| hits_pct  |\n");
+  printf("|-------|-------:|-----------:|-----------:|---------:|----------:"
+         "|----------:|\n");
+
+  std::vector<Ptr<MobilityModel>> bss;
+  bss.push_back(At(0, 0, 1));
+  bss.push_back(At(10, 0, 1));
+  bss.push_back(At(0, 10, 1));
+  bss.push_back(At(10, 10, 1));
+  bss.push_back(At(5, 8.6, 1));
+  Bench("lab2", bss, bss.size(), std::max<uint32_t>(1, queries / 20));
+
+  if (chain >= 2) {
+    std::vector<Ptr<MobilityModel>> line;
+    for (uint32_t i = 0; i < chain; i++) {
+      line.push_back(At(i * 200.0, 0, 1));
+    }
+    uint64_t perRound = uint64_t(chain) * std::min(chain - 1, 2 * neighbours);
+    Bench("chain", line, neighbours,
+          std::max<uint64_t>(1, queries / perRound));
+  }
+  return 0;
+}
@@ -0,0 +1,115 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef RADIO_RANGE_H
+#define RADIO_RANGE_H
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-loss-model.h"
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * Largest distance at which `txDbm` still arrives at or above `cutoffDbm`
+ * through `loss`, for two nodes at height `z`, found by bisection to 0.1 m.
+ * Assumes the loss grows with distance (true for Friis, TwoRayGround,
+ * LogDistance); searching stops at 10,000 km.
+ */
+inline double MaxRadioRange(Ptr<PropagationLossModel> loss, double txDbm,
+                            double cutoffDbm, double z) {
+  Ptr<ConstantPositionMobilityModel> a =
+      CreateObject<ConstantPositionMobilityModel>();
+  Ptr<ConstantPositionMobilityModel> b =
+      CreateObject<ConstantPositionMobilityModel>();
+  a->SetPosition(Vector(0, 0, z));
+  double lo = 0, hi = 1;
+  for (;;) {
+    b->SetPosition(Vector(hi, 0, z));
+    if (loss->CalcRxPower(txDbm, a, b) < cutoffDbm || hi > 1e7) {
+      break;
+    }
+    lo = hi;
+    hi *= 2;
+  }
+  while (hi - lo > 0.1) {
+    double mid = (lo + hi) / 2;
+    b->SetPosition(Vector(mid, 0, z));
+    if (loss->CalcRxPower(txDbm, a, b) < cutoffDbm) {
+      hi = mid;
+    } else {
+      lo = mid;
+    }
+  }
+  return hi;
+}
+
+/*
+ * Positions bucketed in a uniform 3D grid. With the largest range as cell
+ * size, every pair within range lies in the same or neighbouring cells, so
+ * the candidates of a point are the other points of its 3x3x3 block.
+ */
+class RangeGrid {
+public:
+  explicit RangeGrid(double cell) : m_cell(cell) {}
+
+  /* Add the next point; points are numbered from 0 in this order. */
+  void Add(const Vector &p) {
+    Cell c(int64_t(std::floor(p.x / m_cell)),
+           int64_t(std::floor(p.y / m_cell)),
+           int64_t(std::floor(p.z / m_cell)));
+    m_cellOf.push_back(c);
+    m_grid[c].push_back(m_cellOf.size() - 1);
+  }
+
+  /* Call `f(j)` for every point j other than `i` near point `i`. */
+  template <typename F> void ForEachCandidate(size_t i, F f) const {
+    for (int64_t dx = -1; dx <= 1; dx++) {
+      for (int64_t dy = -1; dy <= 1; dy++) {
+        for (int64_t dz = -1; dz <= 1; dz++) {
+          Cell c(std::get<0>(m_cellOf[i]) + dx, std::get<1>(m_cellOf[i]) + dy,
+                 std::get<2>(m_cellOf[i]) + dz);
+          std::map<Cell, std::vector<size_t>>::const_iterator bucket =
+              m_grid.find(c);
+          if (bucket == m_grid.end()) {
+            continue;
+          }
+          for (size_t k = 0; k < bucket->second.size(); k++) {
+            if (bucket->second[k] != i) {
+              f(bucket->second[k]);
+            }
+          }
+        }
+      }
+    }
+  }
+
+private:
+  typedef std::tuple<int64_t, int64_t, int64_t> Cell;
+
+  double m_cell;
+  std::map<Cell, std::vector<size_t>> m_grid;
+  std::vector<Cell> m_cellOf;
+};
+
+} // namespace ns3
+
+#endif /* RADIO_RANGE_H */
@@ -0,0 +1,331 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+#include "sweep-pool.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fnmatch.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <sys/stat.h>
+
+/*
+ * Runs independent replications of one scenario configuration until the
+ * metrics of interest are known precisely enough, e.g.
+ *
+ *   build/scratch/replicate --program=build/scratch/lab2-scenario1p1 \
+ *     --args="--rate=DsssRate11Mbps --pcap=0" --halfWidth=0.02
+ *
+ * Replication k is started with "--<runArg>=k", so every run draws from its
+ * own RngSeedManager substream of the same seed, and writes its run record
+ * to its own file. Every numeric key of the records is folded into a
+ * running mean and variance (Welford) in run-number order, whatever order
+ * the runs finish in. Once at least --minRuns of the runs firstRun..k are
+ * in and the 95% confidence interval of every --metrics key is within
+ * --halfWidth of its mean, no further runs are launched; the ones still in
+ * flight are waited for but left out, so slow runs do not bias the mean. The
+ * summary is printed as a markdown table, optionally followed by the
+ * individual runs.
+ */
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("REPLICATE");
+
+namespace {
+
+/* Running mean and variance of one metric. */
+struct Welford {
+  uint64_t n = 0;
+  double mean = 0;
+  double m2 = 0;
+
+  void Add(double x) {
+    n++;
+    double delta = x - mean;
+    mean += delta / n;
+    m2 += delta * (x - mean);
+  }
+
+  double Variance() const { return n > 1 ? m2 / (n - 1) : 0; }
+};
+
+/* Two-sided 95% quantile of Student's t distribution with `df` degrees of
+ * freedom; between table entries the smaller df is used, which errs on the
+ * wide side. */
+double StudentT95(uint64_t df) {
+  static const double small[] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  if (df == 0) {
+    return INFINITY;
+  }
+  if (df <= 30) {
+    return small[df - 1];
+  }
+  if (df < 40) {
+    return 2.042;
+  }
+  if (df < 60) {
+    return 2.021;
+  }
+  if (df < 120) {
+    return 2.000;
+  }
+  return df < 1000 ? 1.980 : 1.960;
+}
+
+double HalfWidth(const Welford &w) {
+  return w.n > 1 ? StudentT95(w.n - 1) * std::sqrt(w.Variance() / w.n)
+                 : INFINITY;
+}
+
+bool Matches(const std::vector<std::string> &patterns, const std::string &key) {
+  for (size_t i = 0; i < patterns.size(); i++) {
+    if (fnmatch(patterns[i].c_str(), key.c_str(), 0) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string program;
+  std::string extraArgs;
+  std::string runArg("run");
+  uint32_t firstRun = 1;
+  uint32_t minRuns = 5;
+  uint32_t maxRuns = 100;
+  std::string metrics("total,*.goodput,*.success");
+  double halfWidth = 0.02;
+  double absHalfWidth = 0;
+  std::string recordDir("results/replicate");
+  std::string libPath("build/lib");
+  std::string output;
+  bool perRun = false;
+  uint32_t jobs = 0;
+  bool pin = false;
+
+  CommandLine cmd;
+  cmd.AddValue("program", "Path of the built scenario binary", program);
+  cmd.AddValue("args", "Extra arguments passed to every run", extraArgs);
+  cmd.AddValue("runArg", "Option that selects the RNG run, e.g. run or RngRun",
+               runArg);
+  cmd.AddValue("firstRun", "Run number of the first replication", firstRun);
+  cmd.AddValue("minRuns", "Replications always simulated", minRuns);
+  cmd.AddValue("maxRuns", "Upper bound on replications", maxRuns);
+  cmd.AddValue("metrics", "Record keys (globs) that must reach the target",
+               metrics);
+  cmd.AddValue("halfWidth", "Target 95% CI half-width relative to the mean",
+               halfWidth);
+  cmd.AddValue("absHalfWidth", "Absolute half-width that is always good "
+                               "enough, for metrics with a mean near 0",
+               absHalfWidth);
+  cmd.AddValue("recordDir", "Directory for per-run records and logs",
+               recordDir);
+  cmd.AddValue("libPath", "Prepended to LD_LIBRARY_PATH for the runs", libPath);
+  cmd.AddValue("output", "Markdown file for the tables, stdout if empty",
+               output);
+  cmd.AddValue("perRun", "Also list every replication", perRun);
+  cmd.AddValue("jobs", "Concurrent runs, 0 = one per online CPU", jobs);
+  cmd.AddValue("pin", "Pin every worker slot to its own CPU", pin);
+  cmd.Parse(argc, argv);
+
+  if (program.empty()) {
+    std::cerr << "--program is required" << std::endl;
+    return 1;
+  }
+  if (minRuns < 2 || maxRuns < minRuns) {
+    std::cerr << "Need 2 <= --minRuns <= --maxRuns" << std::endl;
+    return 1;
+  }
+
+  if (!libPath.empty()) {
+    const char *old = getenv("LD_LIBRARY_PATH");
+    std::string value = libPath;
+    if (old != nullptr && *old != '\0') {
+      value += ":" + std::string(old);
+    }
+    setenv("LD_LIBRARY_PATH", value.c_str(), 1);
+  }
+  mkdir(recordDir.c_str(), 0755);
+
+  std::vector<std::string> targets = SweepSplit(metrics, ',');
+  std::vector<std::string> extra = SweepSplitArgs(extraArgs);
+  SweepPool pool(jobs, pin);
+  std::cerr << "Replicating " << program << " on " << pool.Workers()
+            << " workers, " << minRuns << " to " << maxRuns << " runs"
+            << std::endl;
+
+  // Keys in order of first appearance, so the table follows the records.
+  std::vector<std::string> keys;
+  std::map<std::string, Welford> stats;
+  std::vector<std::pair<uint32_t, std::map<std::string, double>>> runs;
+  // Finished runs not folded yet by run number, an empty record for a
+  // failed one.
+  std::map<uint32_t, std::vector<std::pair<std::string, double>>> finished;
+  uint32_t nextRun = firstRun;
+  uint32_t launched = 0;
+  uint32_t failed = 0;
+  bool settled = false;
+
+  while ((!settled && launched < maxRuns) || pool.Running() > 0) {
+    while (!settled && launched < maxRuns && pool.HasFreeSlot()) {
+      uint32_t run = firstRun + launched;
+      SweepJob job;
+      job.tag = run;
+      job.id = runArg + "=" + std::to_string(run);
+      std::string record = recordDir + "/run-" + std::to_string(run) + ".txt";
+      remove(record.c_str());
+      job.argv.push_back(program);
+      job.argv.insert(job.argv.end(), extra.begin(), extra.end());
+      job.argv.push_back("--" + runArg + "=" + std::to_string(run));
+      job.argv.push_back("--output=" + record);
+      job.logPath = recordDir + "/run-" + std::to_string(run) + ".log";
+      launched++;
+      if (!pool.Launch(job)) {
+        finished[run].clear();
+        failed++;
+        std::cerr << "[" << job.id << "] fork failed" << std::endl;
+      }
+    }
+
+    SweepResult r;
+    if (!pool.WaitAny(r)) {
+      continue;
+    }
+    std::vector<std::pair<std::string, double>> &values = finished[r.tag];
+    std::string record = recordDir + "/run-" + std::to_string(r.tag) + ".txt";
+    if (r.status != 0 || !SweepReadRecord(record, values)) {
+      values.clear();
+      failed++;
+      std::cerr << "[" << runArg << "=" << r.tag << "] exit " << r.status
+                << ", no record" << std::endl;
+    } else {
+      std::cerr << "[" << runArg << "=" << r.tag << "] done in "
+                << r.wallSeconds << " s" << std::endl;
+    }
+
+    // Fold in run-number order only: runs that take longer (and may well
+    // measure something different) must not be the ones left out when
+    // the criterion is met.
+    while (!settled && finished.count(nextRun) > 0) {
+      const std::vector<std::pair<std::string, double>> &v =
+          finished[nextRun];
+      for (std::vector<std::pair<std::string, double>>::const_iterator i =
+               v.begin();
+           i != v.end(); i++) {
+        if (i->first == "run" || i->first == "seed") {
+          continue;
+        }
+        if (stats.find(i->first) == stats.end()) {
+          keys.push_back(i->first);
+        }
+        stats[i->first].Add(i->second);
+      }
+      if (!v.empty()) {
+        runs.push_back(std::make_pair(
+            nextRun, std::map<std::string, double>(v.begin(), v.end())));
+      }
+      finished.erase(nextRun++);
+
+      // Every matching metric has to be settled, and at least one must
+      // exist.
+      bool done = runs.size() >= minRuns;
+      bool any = false;
+      for (size_t k = 0; k < keys.size() && done; k++) {
+        if (!Matches(targets, keys[k])) {
+          continue;
+        }
+        const Welford &w = stats[keys[k]];
+        any = true;
+        done = HalfWidth(w) <= std::max(halfWidth * std::fabs(w.mean),
+                                        absHalfWidth);
+      }
+      settled = done && any;
+      if (settled) {
+        std::cerr << "Settled after runs " << firstRun << " to "
+                  << nextRun - 1 << ", " << runs.size() << " runs"
+                  << std::endl;
+      }
+    }
+  }
+
+  std::ostringstream md;
+  md << "Replications of " << program << (extraArgs.empty() ? "" : " ")
+     << extraArgs << ": " << runs.size() << " runs ("
+     << (settled ? "target reached" : "target NOT reached") << ", " << failed
+     << " failed)\n\n";
+  md << "| Metric | n | Mean | Std dev | 95% CI | CI rel. |\n";
+  md << "|--------|---|------|---------|--------|---------|\n";
+  for (size_t k = 0; k < keys.size(); k++) {
+    const Welford &w = stats[keys[k]];
+    double hw = HalfWidth(w);
+    char rel[32] = "-";
+    if (w.mean != 0 && std::isfinite(hw)) {
+      snprintf(rel, sizeof(rel), "%.2f %%", 100 * hw / std::fabs(w.mean));
+    }
+    char row[512];
+    snprintf(row, sizeof(row),
+             "| %s%s | %llu | %.4f | %.4f | [%.4f, %.4f] | %s |\n",
+             keys[k].c_str(), Matches(targets, keys[k]) ? " *" : "",
+             (unsigned long long)w.n, w.mean, std::sqrt(w.Variance()),
+             w.mean - hw, w.mean + hw, rel);
+    md << row;
+  }
+  md << "\n* = stopping criterion (half-width <= " << 100 * halfWidth
+     << " % of the mean)\n";
+
+  if (perRun) {
+    md << "\n| Run |";
+    for (size_t k = 0; k < keys.size(); k++) {
+      md << " " << keys[k] << " |";
+    }
+    md << "\n|-----|";
+    for (size_t k = 0; k < keys.size(); k++) {
+      md << "---|";
+    }
+    md << "\n";
+    for (size_t i = 0; i < runs.size(); i++) {
+      md << "| " << runs[i].first << " |";
+      for (size_t k = 0; k < keys.size(); k++) {
+        std::map<std::string, double>::const_iterator v =
+            runs[i].second.find(keys[k]);
+        if (v == runs[i].second.end()) {
+          md << " - |";
+        } else {
+          md << " " << v->second << " |";
+        }
+      }
+      md << "\n";
+    }
+  }
+
+  if (output.empty()) {
+    std::cout << md.str();
+  } else {
+    std::ofstream out(output.c_str());
+    out << md.str();
+  }
+  return settled ? 0 : 2;
+}
@@ -0,0 +1,336 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include "sweep-pool.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <elf.h>
+#include <fcntl.h>
+#include <fstream>
+#include <sqlite3.h>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+/*
+ * SQLite store of finished scenario runs, keyed by a hash of everything that
+ * determines their outcome (see ResultCacheConfig() in sweep.cc).
+ *
+ * A run is its exit status, timings, log and the files it wrote. File and log
+ * contents are stored once per distinct content in `blobs`, so configurations
+ * that produce identical traces share them. Stores are grouped into
+ * transactions of `batch` runs, committed when the batch is full and on
+ * Close(); a sweep that is interrupted loses at most the last batch.
+ */
+
+/* 128-bit FNV-1a of `data`, as 32 hex digits. */
+inline std::string ResultCacheHash(const std::string &data) {
+  __extension__ typedef unsigned __int128 u128;
+  const u128 prime = (u128(1) << 88) + (1 << 8) + 0x3b;
+  u128 h = (u128(0x6c62272e07bb0142ULL) << 64) + 0x62b821756295c58dULL;
+  for (size_t i = 0; i < data.size(); i++) {
+    h ^= (unsigned char)data[i];
+    h *= prime;
+  }
+  char hex[33];
+  snprintf(hex, sizeof(hex), "%016llx%016llx", (unsigned long long)(h >> 64),
+           (unsigned long long)h);
+  return hex;
+}
+
+inline bool ResultCacheReadFile(const std::string &path, std::string &out) {
+  std::ifstream in(path.c_str(), std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  std::ostringstream data;
+  data << in.rdbuf();
+  out = data.str();
+  return true;
+}
+
+/*
+ * GNU build ID of an ELF file, "" if it has none. Reads the PT_NOTE segments
+ * only, so this is cheap even for the large debug builds of the ns-3 libs.
+ */
+inline std::string ResultCacheBuildId(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return "";
+  }
+  std::string id;
+  Elf64_Ehdr eh;
+  if (pread(fd, &eh, sizeof(eh), 0) == ssize_t(sizeof(eh)) &&
+      memcmp(eh.e_ident, ELFMAG, SELFMAG) == 0 &&
+      eh.e_ident[EI_CLASS] == ELFCLASS64) {
+    for (unsigned i = 0; i < eh.e_phnum && id.empty(); i++) {
+      Elf64_Phdr ph;
+      if (pread(fd, &ph, sizeof(ph), eh.e_phoff + i * eh.e_phentsize) !=
+              ssize_t(sizeof(ph)) ||
+          ph.p_type != PT_NOTE || ph.p_filesz > (1 << 16)) {
+        continue;
+      }
+      std::vector<char> notes(ph.p_filesz);
+      if (pread(fd, notes.data(), notes.size(), ph.p_offset) !=
+          ssize_t(notes.size())) {
+        continue;
+      }
+      size_t pos = 0;
+      while (pos + sizeof(Elf64_Nhdr) <= notes.size()) {
+        Elf64_Nhdr nh;
+        memcpy(&nh, &notes[pos], sizeof(nh));
+        size_t name = pos + sizeof(nh);
+        size_t desc = name + ((nh.n_namesz + 3) & ~3u);
+        pos = desc + ((nh.n_descsz + 3) & ~3u);
+        if (pos > notes.size()) {
+          break;
+        }
+        if (nh.n_type == NT_GNU_BUILD_ID && nh.n_namesz == 4 &&
+            memcmp(&notes[name], "GNU", 4) == 0) {
+          for (size_t b = 0; b < nh.n_descsz; b++) {
+            char hex[3];
+            snprintf(hex, sizeof(hex), "%02x", (unsigned char)notes[desc + b]);
+            id += hex;
+          }
+          break;
+        }
+      }
+    }
+  }
+  close(fd);
+  return id;
+}
+
+/* Build ID of `path`, or the hash of its contents when it has none. */
+inline std::string ResultCacheFileId(const std::string &path) {
+  std::string id = ResultCacheBuildId(path);
+  if (!id.empty()) {
+    return "build-id:" + id;
+  }
+  std::string data;
+  if (!ResultCacheReadFile(path, data)) {
+    return "missing";
+  }
+  return "fnv:" + ResultCacheHash(data);
+}
+
+/* Everything kept about one finished run. */
+struct CachedRun {
+  int status = 0;
+  double wallSeconds = 0;
+  long maxRssKb = 0;
+  std::string log;
+  std::vector<std::pair<std::string, std::string>> files; // path, contents
+};
+
+class ResultCache {
+public:
+  explicit ResultCache(unsigned batch = 32)
+      : m_db(nullptr), m_getRun(nullptr), m_getFiles(nullptr),
+        m_putBlob(nullptr), m_putRun(nullptr), m_delFiles(nullptr),
+        m_putFile(nullptr), m_batch(std::max(1u, batch)), m_pending(0) {}
+
+  ~ResultCache() { Close(); }
+
+  bool Open(const std::string &path, std::string &error) {
+    if (sqlite3_open(path.c_str(), &m_db) != SQLITE_OK) {
+      error = m_db ? sqlite3_errmsg(m_db) : "out of memory";
+      Close();
+      return false;
+    }
+    sqlite3_busy_timeout(m_db, 10000);
+    const char *schema =
+        "CREATE TABLE IF NOT EXISTS blobs ("
+        "  hash TEXT PRIMARY KEY, data BLOB NOT NULL);"
+        "CREATE TABLE IF NOT EXISTS runs ("
+        "  key TEXT PRIMARY KEY, config TEXT NOT NULL, status INTEGER,"
+        "  wall_s REAL, max_rss_kb INTEGER, log TEXT, created INTEGER);"
+        "CREATE TABLE IF NOT EXISTS files ("
+        "  key TEXT, path TEXT, blob TEXT, PRIMARY KEY (key, path));";
+    if (!Exec(schema) ||
+        !Prepare("SELECT config, status, wall_s, max_rss_kb,"
+                 " (SELECT data FROM blobs WHERE hash = log)"
+                 " FROM runs WHERE key = ?",
+                 &m_getRun) ||
+        !Prepare("SELECT path, data FROM files JOIN blobs ON blob = hash"
+                 " WHERE key = ? ORDER BY path",
+                 &m_getFiles) ||
+        !Prepare("INSERT OR IGNORE INTO blobs VALUES (?, ?)", &m_putBlob) ||
+        !Prepare("INSERT OR REPLACE INTO runs"
+                 " VALUES (?, ?, ?, ?, ?, ?, strftime('%s', 'now'))",
+                 &m_putRun) ||
+        !Prepare("DELETE FROM files WHERE key = ?", &m_delFiles) ||
+        !Prepare("INSERT INTO files VALUES (?, ?, ?)", &m_putFile)) {
+      error = sqlite3_errmsg(m_db);
+      Close();
+      return false;
+    }
+    return true;
+  }
+
+  /* Commit the open batch and release the database. */
+  void Close() {
+    if (m_db == nullptr) {
+      return;
+    }
+    Commit();
+    sqlite3_stmt *stmts[] = {m_getRun,  m_getFiles, m_putBlob, m_putRun,
+                             m_delFiles, m_putFile};
+    for (size_t i = 0; i < sizeof(stmts) / sizeof(stmts[0]); i++) {
+      sqlite3_finalize(stmts[i]);
+    }
+    m_getRun = m_getFiles = m_putBlob = m_putRun = m_delFiles = m_putFile =
+        nullptr;
+    sqlite3_close(m_db);
+    m_db = nullptr;
+  }
+
+  /*
+   * Fill `run` from the store. `config` is compared with the stored text, so
+   * a hash collision is a miss rather than a wrong result.
+   */
+  bool Lookup(const std::string &key, const std::string &config,
+              CachedRun &run) {
+    Bind(m_getRun, 1, key);
+    bool found = false;
+    if (sqlite3_step(m_getRun) == SQLITE_ROW && Column(m_getRun, 0) == config) {
+      found = true;
+      run.status = sqlite3_column_int(m_getRun, 1);
+      run.wallSeconds = sqlite3_column_double(m_getRun, 2);
+      run.maxRssKb = sqlite3_column_int64(m_getRun, 3);
+      run.log = Column(m_getRun, 4);
+    }
+    sqlite3_reset(m_getRun);
+    if (!found) {
+      return false;
+    }
+    run.files.clear();
+    Bind(m_getFiles, 1, key);
+    while (sqlite3_step(m_getFiles) == SQLITE_ROW) {
+      run.files.push_back(
+          std::make_pair(Column(m_getFiles, 0), Column(m_getFiles, 1)));
+    }
+    sqlite3_reset(m_getFiles);
+    return true;
+  }
+
+  bool Store(const std::string &key, const std::string &config,
+             const CachedRun &run) {
+    if (m_pending == 0 && !Exec("BEGIN")) {
+      return false;
+    }
+    bool ok = true;
+    std::string log = PutBlob(run.log, ok);
+    Bind(m_putRun, 1, key);
+    Bind(m_putRun, 2, config);
+    sqlite3_bind_int(m_putRun, 3, run.status);
+    sqlite3_bind_double(m_putRun, 4, run.wallSeconds);
+    sqlite3_bind_int64(m_putRun, 5, run.maxRssKb);
+    Bind(m_putRun, 6, log);
+    ok = Step(m_putRun) && ok;
+    Bind(m_delFiles, 1, key);
+    ok = Step(m_delFiles) && ok;
+    for (size_t i = 0; i < run.files.size(); i++) {
+      std::string blob = PutBlob(run.files[i].second, ok);
+      Bind(m_putFile, 1, key);
+      Bind(m_putFile, 2, run.files[i].first);
+      Bind(m_putFile, 3, blob);
+      ok = Step(m_putFile) && ok;
+    }
+    if (++m_pending >= m_batch) {
+      Commit();
+    }
+    return ok;
+  }
+
+  /* Write the files of a cached run back to where the run left them. */
+  static bool Restore(const CachedRun &run) {
+    bool ok = true;
+    for (size_t i = 0; i < run.files.size(); i++) {
+      const std::string &path = run.files[i].first;
+      std::string::size_type slash = path.rfind('/');
+      if (slash != std::string::npos && slash > 0) {
+        SweepMakeDirs(path.substr(0, slash));
+      }
+      std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+      out.write(run.files[i].second.data(), run.files[i].second.size());
+      ok = ok && bool(out);
+    }
+    return ok;
+  }
+
+private:
+  bool Exec(const char *sql) {
+    return sqlite3_exec(m_db, sql, nullptr, nullptr, nullptr) == SQLITE_OK;
+  }
+
+  bool Prepare(const char *sql, sqlite3_stmt **stmt) {
+    return sqlite3_prepare_v2(m_db, sql, -1, stmt, nullptr) == SQLITE_OK;
+  }
+
+  static void Bind(sqlite3_stmt *stmt, int index, const std::string &text) {
+    sqlite3_bind_text(stmt, index, text.data(), text.size(),
+                      SQLITE_TRANSIENT);
+  }
+
+  static std::string Column(sqlite3_stmt *stmt, int index) {
+    const char *data = (const char *)sqlite3_column_blob(stmt, index);
+    return std::string(data ? data : "", sqlite3_column_bytes(stmt, index));
+  }
+
+  static bool Step(sqlite3_stmt *stmt) {
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE;
+  }
+
+  /* Store `data` under its content hash and return the hash. */
+  std::string PutBlob(const std::string &data, bool &ok) {
+    std::string hash = ResultCacheHash(data);
+    Bind(m_putBlob, 1, hash);
+    sqlite3_bind_blob(m_putBlob, 2, data.data(), data.size(),
+                      SQLITE_TRANSIENT);
+    ok = Step(m_putBlob) && ok;
+    return hash;
+  }
+
+  void Commit() {
+    if (m_pending > 0) {
+      Exec("COMMIT");
+      m_pending = 0;
+    }
+  }
+
+  sqlite3 *m_db;
+  sqlite3_stmt *m_getRun;
+  sqlite3_stmt *m_getFiles;
+  sqlite3_stmt *m_putBlob;
+  sqlite3_stmt *m_putRun;
+  sqlite3_stmt *m_delFiles;
+  sqlite3_stmt *m_putFile;
+  unsigned m_batch;
+  unsigned m_pending;
+};
+
+#endif /* RESULT_CACHE_H */
@@ -0,0 +1,136 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ROUTE_GATE_H
+#define ROUTE_GATE_H
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+#include "ns3/olsr-module.h"
+#include "run-record.h"
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * Holds back traffic until OLSR has routes between both ends of every
+ * watched flow.
+ *
+ * A TCP connect without a route fails for good (TcpSocketBase leaves the
+ * socket closed and OnOffApplication ignores the error), and OLSR has no
+ * routes at t=0. Instead of a fixed start delay, the gate checks the
+ * watched pairs with RouteOutput() whenever the OLSR table of one of their
+ * nodes is recomputed ("RoutingTableChanged") and runs the OnReady()
+ * actions as soon as all of them are routed, typically after the first
+ * HELLO exchanges for neighbours and a TC interval for longer paths.
+ */
+class RouteGate {
+public:
+  RouteGate() : m_ready(Seconds(-1)), m_open(false) {}
+
+  /* Wait for routes from `a` to `b` and back. */
+  void Watch(Ptr<Node> a, Ipv4Address aAddress, Ptr<Node> b,
+             Ipv4Address bAddress) {
+    Pair p = {a, aAddress, b, bAddress};
+    m_pairs.push_back(p);
+    ConnectOlsr(a);
+    ConnectOlsr(b);
+  }
+
+  /* Run `action` once all watched pairs are routed. */
+  void OnReady(const std::function<void()> &action) {
+    m_actions.push_back(action);
+  }
+
+  /* Start waiting; routes that already exist open the gate right away. */
+  void Start() { Simulator::ScheduleNow(&RouteGate::Check, this); }
+
+  /* "route_s": when the last pair was routed, -1 if some never were. */
+  void Record(RunRecord &record) const {
+    record.Add("route_s", m_ready.IsNegative() ? -1.0 : m_ready.GetSeconds());
+  }
+
+private:
+  struct Pair {
+    Ptr<Node> a;
+    Ipv4Address aAddress;
+    Ptr<Node> b;
+    Ipv4Address bAddress;
+  };
+
+  void ConnectOlsr(Ptr<Node> node) {
+    if (!m_connected.insert(node->GetId()).second) {
+      return;
+    }
+    Ptr<Ipv4ListRouting> list = DynamicCast<Ipv4ListRouting>(
+        node->GetObject<Ipv4>()->GetRoutingProtocol());
+    for (uint32_t i = 0; list && i < list->GetNRoutingProtocols(); i++) {
+      int16_t priority;
+      Ptr<olsr::RoutingProtocol> olsr = DynamicCast<olsr::RoutingProtocol>(
+          list->GetRoutingProtocol(i, priority));
+      if (olsr) {
+        olsr->TraceConnectWithoutContext(
+            "RoutingTableChanged", MakeCallback(&RouteGate::Changed, this));
+      }
+    }
+  }
+
+  static bool HasRoute(Ptr<Node> from, Ipv4Address to) {
+    Ipv4Header header;
+    header.SetDestination(to);
+    Socket::SocketErrno error;
+    return from->GetObject<Ipv4>()->GetRoutingProtocol()->RouteOutput(
+               Ptr<Packet>(), header, 0, error) != 0;
+  }
+
+  void Changed(uint32_t size) {
+    // Not from inside the OLSR table computation
+    if (!m_open) {
+      Simulator::ScheduleNow(&RouteGate::Check, this);
+    }
+  }
+
+  void Check() {
+    if (m_open) {
+      return;
+    }
+    for (size_t i = 0; i < m_pairs.size(); i++) {
+      if (!HasRoute(m_pairs[i].a, m_pairs[i].bAddress) ||
+          !HasRoute(m_pairs[i].b, m_pairs[i].aAddress)) {
+        return;
+      }
+    }
+    m_open = true;
+    m_ready = Simulator::Now();
+    for (size_t i = 0; i < m_actions.size(); i++) {
+      m_actions[i]();
+    }
+  }
+
+  std::vector<Pair> m_pairs;
+  std::set<uint32_t> m_connected;
+  Time m_ready;
+  bool m_open;
+  std::vector<std::function<void()>> m_actions;
+};
+
+} // namespace ns3
+
+#endif /* ROUTE_GATE_H */
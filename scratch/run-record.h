@@ -0,0 +1,112 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef RUN_RECORD_H
+#define RUN_RECORD_H
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+/*
+ * One line of "key=value" pairs describing a single simulation run. All
+ * scenarios in scratch/ emit their results this way so that the sweep and
+ * replication tools can parse any of them without knowing the scenario.
+ */
+class RunRecord {
+public:
+  template <typename T> void Add(const std::string &key, const T &value) {
+    std::ostringstream os;
+    os << value;
+    m_fields.push_back(std::make_pair(key, os.str()));
+  }
+
+  std::string ToString() const {
+    std::string line;
+    for (size_t i = 0; i < m_fields.size(); i++) {
+      line += (i ? " " : "") + m_fields[i].first + "=" + m_fields[i].second;
+    }
+    return line;
+  }
+
+  /* Append the record as one line to `path`, or print it if `path` is "". */
+  void Write(const std::string &path) const {
+    if (path.empty()) {
+      std::cout << ToString() << std::endl;
+      return;
+    }
+    std::ofstream out(path.c_str(), std::ios::app);
+    out << ToString() << "\n";
+  }
+
+private:
+  std::vector<std::pair<std::string, std::string>> m_fields;
+};
+
+/* Wall-clock stopwatch started on construction. */
+class WallTimer {
+public:
+  WallTimer() : m_start(std::chrono::steady_clock::now()) {}
+
+  double Seconds() const {
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - m_start;
+    return d.count();
+  }
+
+private:
+  std::chrono::steady_clock::time_point m_start;
+};
+
+/*
+ * Seconds elapsed since this process was exec()ed, i.e. dynamic loading of
+ * the ns-3 libraries, static TypeId registration and everything main() did so
+ * far. Resolution is one clock tick (usually 10 ms); returns -1 if /proc is
+ * not available.
+ */
+inline double ProcessUptimeSeconds() {
+  std::ifstream stat("/proc/self/stat");
+  std::ifstream uptime("/proc/uptime");
+  std::string line;
+  double sinceBoot = 0;
+  if (!std::getline(stat, line) || !(uptime >> sinceBoot)) {
+    return -1;
+  }
+  // The command name may contain spaces, so skip past its closing bracket.
+  std::istringstream fields(line.substr(line.rfind(')') + 2));
+  std::string field;
+  for (int i = 3; i < 22 && fields >> field; i++) {
+  }
+  unsigned long long startTicks = 0;
+  if (!(fields >> startTicks)) {
+    return -1;
+  }
+  return sinceBoot - double(startTicks) / sysconf(_SC_CLK_TCK);
+}
+
+/* Peak resident set size of this process in kB. */
+inline long PeakRssKb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+#endif /* RUN_RECORD_H */
@@ -0,0 +1,307 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SATURATING_SOURCE_H
+#define SATURATING_SOURCE_H
+
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+#include "ns3/wifi-module.h"
+#include <algorithm>
+#include <string>
+
+namespace ns3 {
+
+/*
+ * Saturated traffic source that only generates a packet when the MAC queue of
+ * its node's Wi-Fi device has room for it.
+ *
+ * An OnOffApplication offering far more than the link rate keeps the
+ * WifiMacQueue full just as well, but every packet above the link rate is
+ * allocated, scheduled, pushed through UDP/IP and then dropped at the queue.
+ * This source instead keeps "Backlog" packets queued: it tops the queue up
+ * whenever the queue reports a dequeue or drop, so the MAC never idles and
+ * almost nothing is thrown away.
+ *
+ * Packets that do not reach the queue (no route yet, ARP resolution pending)
+ * are retried after "RetryInterval". "OnTime"/"OffTime" follow the same
+ * on/off pattern as OnOffApplication; during an on period the source is
+ * saturated instead of sending at a fixed rate.
+ */
+class SaturatingSource : public Application {
+public:
+  static TypeId GetTypeId() {
+    static TypeId tid =
+        TypeId("ns3::SaturatingSource")
+            .SetParent<Application>()
+            .SetGroupName("Applications")
+            .AddConstructor<SaturatingSource>()
+            .AddAttribute("Remote", "The address of the destination.",
+                          AddressValue(),
+                          MakeAddressAccessor(&SaturatingSource::m_peer),
+                          MakeAddressChecker())
+            .AddAttribute("Protocol", "The type of protocol to use.",
+                          TypeIdValue(UdpSocketFactory::GetTypeId()),
+                          MakeTypeIdAccessor(&SaturatingSource::m_tid),
+                          MakeTypeIdChecker())
+            .AddAttribute("PacketSize", "The size of packets sent.",
+                          UintegerValue(512),
+                          MakeUintegerAccessor(&SaturatingSource::m_size),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute(
+                "Backlog", "Packets kept in the MAC queue while on.",
+                UintegerValue(2),
+                MakeUintegerAccessor(&SaturatingSource::m_backlog),
+                MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute(
+                "RetryInterval",
+                "Wait before retrying a packet that did not reach the queue.",
+                TimeValue(MilliSeconds(10)),
+                MakeTimeAccessor(&SaturatingSource::m_retryInterval),
+                MakeTimeChecker())
+            .AddAttribute(
+                "OnTime", "Length of the saturated periods [s].",
+                StringValue("ns3::ConstantRandomVariable[Constant=1.0]"),
+                MakePointerAccessor(&SaturatingSource::m_onTime),
+                MakePointerChecker<RandomVariableStream>())
+            .AddAttribute(
+                "OffTime", "Length of the silent periods [s].",
+                StringValue("ns3::ConstantRandomVariable[Constant=0.0]"),
+                MakePointerAccessor(&SaturatingSource::m_offTime),
+                MakePointerChecker<RandomVariableStream>())
+            .AddTraceSource(
+                "Tx", "A new packet is created and is sent",
+                MakeTraceSourceAccessor(&SaturatingSource::m_txTrace),
+                "ns3::Packet::TracedCallback");
+    return tid;
+  }
+
+  SaturatingSource()
+      : m_size(512), m_backlog(2), m_on(false), m_sending(false),
+        m_dequeues(0), m_drops(0), m_sent(0) {}
+
+  /* Packets handed to the socket so far. */
+  uint64_t GetSent() const { return m_sent; }
+
+private:
+  virtual void DoDispose() {
+    m_socket = 0;
+    m_queue = 0;
+    Application::DoDispose();
+  }
+
+  virtual void StartApplication() {
+    m_queue = FindQueue();
+    NS_ABORT_MSG_IF(m_queue == 0, "SaturatingSource needs a Wi-Fi device");
+    m_queue->TraceConnectWithoutContext(
+        "Dequeue", MakeCallback(&SaturatingSource::QueueDrained, this));
+    m_queue->TraceConnectWithoutContext(
+        "Drop", MakeCallback(&SaturatingSource::QueueDropped, this));
+
+    m_socket = Socket::CreateSocket(GetNode(), m_tid);
+    if (Inet6SocketAddress::IsMatchingType(m_peer)) {
+      m_socket->Bind6();
+    } else {
+      m_socket->Bind();
+    }
+    m_socket->Connect(m_peer);
+    m_socket->SetAllowBroadcast(true);
+    m_socket->ShutdownRecv();
+    StartOn();
+  }
+
+  virtual void StopApplication() {
+    m_on = false;
+    Simulator::Cancel(m_periodEvent);
+    Simulator::Cancel(m_refillEvent);
+    if (m_queue != 0) {
+      m_queue->TraceDisconnectWithoutContext(
+          "Dequeue", MakeCallback(&SaturatingSource::QueueDrained, this));
+      m_queue->TraceDisconnectWithoutContext(
+          "Drop", MakeCallback(&SaturatingSource::QueueDropped, this));
+    }
+    if (m_socket != 0) {
+      m_socket->Close();
+    }
+  }
+
+  /* The queue of the first Wi-Fi device, DCF or best-effort EDCA. */
+  Ptr<WifiMacQueue> FindQueue() const {
+    for (uint32_t i = 0; i < GetNode()->GetNDevices(); i++) {
+      Ptr<WifiNetDevice> dev =
+          DynamicCast<WifiNetDevice>(GetNode()->GetDevice(i));
+      if (dev == 0) {
+        continue;
+      }
+      BooleanValue qos;
+      dev->GetMac()->GetAttribute("QosSupported", qos);
+      PointerValue txop;
+      dev->GetMac()->GetAttribute(qos.Get() ? "BE_Txop" : "Txop", txop);
+      return txop.Get<Txop>()->GetWifiMacQueue();
+    }
+    return 0;
+  }
+
+  void StartOn() {
+    m_on = true;
+    m_periodEvent = Simulator::Schedule(
+        Seconds(std::max(0.0, m_onTime->GetValue())), &SaturatingSource::EndOn,
+        this);
+    Refill();
+  }
+
+  void EndOn() {
+    m_on = false;
+    Simulator::Cancel(m_refillEvent);
+    m_periodEvent = Simulator::Schedule(
+        Seconds(std::max(0.0, m_offTime->GetValue())),
+        &SaturatingSource::StartOn, this);
+  }
+
+  void QueueDrained(Ptr<const WifiMacQueueItem> item) {
+    m_dequeues++;
+    Wake();
+  }
+
+  void QueueDropped(Ptr<const WifiMacQueueItem> item) {
+    m_drops++;
+    Wake();
+  }
+
+  void Wake() {
+    // Refill() sees what happens inside its own Send() itself, and is never
+    // run from the trace callback directly.
+    if (m_on && !m_sending && !m_refillEvent.IsRunning()) {
+      m_refillEvent = Simulator::ScheduleNow(&SaturatingSource::Refill, this);
+    }
+  }
+
+  void Refill() {
+    Simulator::Cancel(m_refillEvent);
+    while (m_on && m_queue->GetNPackets() < m_backlog) {
+      uint32_t queued = m_queue->GetNPackets();
+      uint64_t dequeues = m_dequeues;
+      uint64_t drops = m_drops;
+      Ptr<Packet> packet = Create<Packet>(m_size);
+      m_txTrace(packet);
+      m_sending = true;
+      if (m_socket->Send(packet) >= 0) {
+        m_sent++;
+      }
+      m_sending = false;
+      if (m_drops != drops) {
+        // The queue is full (Backlog at or above its MaxSize); its next
+        // dequeue wakes us up again.
+        return;
+      }
+      if (m_queue->GetNPackets() <= queued && m_dequeues == dequeues) {
+        // Swallowed on the way down (no route, ARP pending); the queue will
+        // not wake us up for it.
+        m_refillEvent = Simulator::Schedule(m_retryInterval,
+                                            &SaturatingSource::Refill, this);
+        return;
+      }
+    }
+  }
+
+  Address m_peer;
+  TypeId m_tid;
+  uint32_t m_size;
+  uint32_t m_backlog;
+  Time m_retryInterval;
+  Ptr<RandomVariableStream> m_onTime;
+  Ptr<RandomVariableStream> m_offTime;
+  Ptr<Socket> m_socket;
+  Ptr<WifiMacQueue> m_queue;
+  bool m_on;
+  bool m_sending;
+  uint64_t m_dequeues;
+  uint64_t m_drops;
+  uint64_t m_sent;
+  EventId m_periodEvent;
+  EventId m_refillEvent;
+  TracedCallback<Ptr<const Packet>> m_txTrace;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(SaturatingSource);
+
+/* Counterpart of OnOffHelper for SaturatingSource. */
+class SaturatingSourceHelper {
+public:
+  SaturatingSourceHelper(const std::string &protocol, const Address &remote) {
+    m_factory.SetTypeId(SaturatingSource::GetTypeId());
+    m_factory.Set("Protocol", TypeIdValue(TypeId::LookupByName(protocol)));
+    m_factory.Set("Remote", AddressValue(remote));
+  }
+
+  void SetAttribute(const std::string &name, const AttributeValue &value) {
+    m_factory.Set(name, value);
+  }
+
+  ApplicationContainer Install(Ptr<Node> node) const {
+    Ptr<Application> app = m_factory.Create<Application>();
+    node->AddApplication(app);
+    return ApplicationContainer(app);
+  }
+
+private:
+  ObjectFactory m_factory;
+};
+
+/*
+ * Builds an OnOffApplication or, with `saturate`, a SaturatingSource, so a
+ * scenario sets the on/off pattern once for both. Attributes only an
+ * OnOffApplication has (DataRate) go through SetOnOffAttribute() and
+ * are dropped for a SaturatingSource.
+ */
+class OnOffSourceHelper {
+public:
+  OnOffSourceHelper(const std::string &protocol, bool saturate)
+      : m_saturate(saturate) {
+    m_factory.SetTypeId(saturate ? SaturatingSource::GetTypeId()
+                                 : OnOffApplication::GetTypeId());
+    m_factory.Set("Protocol", TypeIdValue(TypeId::LookupByName(protocol)));
+  }
+
+  void SetAttribute(const std::string &name, const AttributeValue &value) {
+    m_factory.Set(name, value);
+  }
+
+  void SetOnOffAttribute(const std::string &name,
+                         const AttributeValue &value) {
+    if (!m_saturate) {
+      m_factory.Set(name, value);
+    }
+  }
+
+  /* One source on `node` sending to `remote`. */
+  ApplicationContainer Install(Ptr<Node> node, const Address &remote) {
+    m_factory.Set("Remote", AddressValue(remote));
+    Ptr<Application> app = m_factory.Create<Application>();
+    node->AddApplication(app);
+    return ApplicationContainer(app);
+  }
+
+private:
+  bool m_saturate;
+  ObjectFactory m_factory;
+};
+
+} // namespace ns3
+
+#endif /* SATURATING_SOURCE_H */
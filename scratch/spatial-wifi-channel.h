@@ -0,0 +1,147 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SPATIAL_WIFI_CHANNEL_H
+#define SPATIAL_WIFI_CHANNEL_H
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/wifi-module.h"
+#include "radio-range.h"
+#include <cmath>
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * YansWifiChannel schedules a receive event on every PHY of the channel for
+ * every frame, including PHYs kilometres away that can neither decode nor
+ * sense it. For static topologies this helper gives every transmitter a
+ * YansWifiChannel of its own that only lists the PHYs inside its useful
+ * range, so a frame costs O(neighbours) events instead of O(N).
+ *
+ * The useful range is where the received power still reaches the cutoff,
+ * by default the lower of EnergyDetectionThreshold and CcaMode1Threshold. It
+ * is derived from each PHY's TxPowerEnd/TxGain and the loss model by
+ * bisection, assuming loss grows with distance (true for Friis, TwoRayGround,
+ * LogDistance) and does not grow with antenna height. Nodes are bucketed in a
+ * uniform 3D grid with that range as cell size, and every candidate pair from
+ * neighbouring cells is confirmed with the exact CalcRxPower of the loss
+ * model. Both steps live in radio-range.h, shared with
+ * StaticMeshRoutingHelper.
+ *
+ * Only signals below the cutoff are dropped; they would not have triggered
+ * reception or CCA, but they did add a tiny amount of interference energy.
+ * Positions are sampled once in Install(), so nodes must not move.
+ */
+class SpatialWifiChannelHelper {
+public:
+  SpatialWifiChannelHelper(Ptr<PropagationLossModel> loss,
+                           Ptr<PropagationDelayModel> delay)
+      : m_loss(loss), m_delay(delay), m_cutoffDbm(NAN), m_links(0) {}
+
+  /* Override the cutoff below which receivers are skipped [dBm]. */
+  void SetCutoff(double dbm) { m_cutoffDbm = dbm; }
+
+  /* Replace the channel of every YansWifiPhy in `devices`. */
+  void Install(NetDeviceContainer devices) {
+    std::vector<Ptr<YansWifiPhy>> phys;
+    std::vector<Ptr<MobilityModel>> mobility;
+    std::vector<double> txDbm;
+    for (NetDeviceContainer::Iterator i = devices.Begin(); i != devices.End();
+         i++) {
+      Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>(*i);
+      Ptr<YansWifiPhy> phy =
+          dev ? DynamicCast<YansWifiPhy>(dev->GetPhy()) : Ptr<YansWifiPhy>();
+      if (phy == 0) {
+        continue;
+      }
+      Ptr<MobilityModel> mm = dev->GetNode()->GetObject<MobilityModel>();
+      NS_ABORT_MSG_IF(mm == 0, "SpatialWifiChannelHelper needs mobility");
+      phys.push_back(phy);
+      mobility.push_back(mm);
+      txDbm.push_back(phy->GetTxPowerEnd() + phy->GetTxGain());
+    }
+    if (phys.empty()) {
+      return;
+    }
+
+    double cutoff = m_cutoffDbm;
+    if (std::isnan(cutoff)) {
+      DoubleValue ed, cca;
+      phys[0]->GetAttribute("EnergyDetectionThreshold", ed);
+      phys[0]->GetAttribute("CcaMode1Threshold", cca);
+      cutoff = std::min(ed.Get(), cca.Get());
+    }
+    double rxGain = phys[0]->GetRxGain();
+    // Higher antennas only gain in the two-ray regime, so the range found
+    // with every node at the highest z bounds all pairs.
+    double z = 0;
+    for (size_t i = 0; i < mobility.size(); i++) {
+      z = std::max(z, mobility[i]->GetPosition().z);
+    }
+
+    // One range per transmit power level; the largest one sizes the grid.
+    std::map<double, double> rangeOf;
+    double cell = 1;
+    for (size_t i = 0; i < phys.size(); i++) {
+      if (rangeOf.find(txDbm[i]) == rangeOf.end()) {
+        rangeOf[txDbm[i]] = MaxRadioRange(m_loss, txDbm[i] + rxGain, cutoff, z);
+      }
+      cell = std::max(cell, rangeOf[txDbm[i]]);
+    }
+
+    RangeGrid grid(cell);
+    for (size_t i = 0; i < phys.size(); i++) {
+      grid.Add(mobility[i]->GetPosition());
+    }
+
+    for (size_t i = 0; i < phys.size(); i++) {
+      Ptr<YansWifiChannel> channel = CreateObject<YansWifiChannel>();
+      channel->SetPropagationLossModel(m_loss);
+      channel->SetPropagationDelayModel(m_delay);
+      phys[i]->SetChannel(channel);
+
+      double range = rangeOf[txDbm[i]];
+      grid.ForEachCandidate(i, [&](size_t j) {
+        if (mobility[i]->GetDistanceFrom(mobility[j]) > range ||
+            m_loss->CalcRxPower(txDbm[i], mobility[i], mobility[j]) +
+                    phys[j]->GetRxGain() <
+                cutoff) {
+          return;
+        }
+        channel->Add(phys[j]);
+        m_links++;
+      });
+    }
+  }
+
+  /* Directed transmitter/receiver pairs kept by the last Install(). */
+  uint64_t GetLinkCount() const { return m_links; }
+
+private:
+  Ptr<PropagationLossModel> m_loss;
+  Ptr<PropagationDelayModel> m_delay;
+  double m_cutoffDbm;
+  uint64_t m_links;
+};
+
+} // namespace ns3
+
+#endif /* SPATIAL_WIFI_CHANNEL_H */
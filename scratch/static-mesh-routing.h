@@ -0,0 +1,235 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef STATIC_MESH_ROUTING_H
+#define STATIC_MESH_ROUTING_H
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/wifi-module.h"
+#include "radio-range.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * Minimum-hop host routes for a static ad hoc network, computed once from
+ * the node positions instead of being discovered by OLSR at run time.
+ *
+ * Two devices are neighbours when each receives the other's frames at or
+ * above the receiver's EnergyDetectionThreshold, given the sender's
+ * TxPowerEnd/TxGain and the loss model; both directions are needed since
+ * every unicast frame is ACKed. Candidate pairs come from a uniform grid
+ * with the largest such range as cell size (RangeGrid in radio-range.h), so
+ * setup stays near O(N) for sparse layouts.
+ *
+ * Install() runs one breadth-first search per destination and gives every
+ * node that can reach it an Ipv4StaticRouting host route to the
+ * destination's address. Among equally short next hops the one received
+ * strongest wins, which keeps the result independent of node numbering.
+ * The nodes need an Ipv4StaticRouting (directly or in an
+ * Ipv4ListRoutingProtocol) and assigned addresses.
+ */
+class StaticMeshRoutingHelper {
+public:
+  explicit StaticMeshRoutingHelper(Ptr<PropagationLossModel> loss)
+      : m_loss(loss), m_links(0), m_routes(0), m_unreachable(0) {}
+
+  /*
+   * Add routes on every node with a WifiNetDevice in `devices` to each node
+   * in `destinations`.
+   */
+  void Install(NetDeviceContainer devices, NodeContainer destinations) {
+    BuildGraph(devices);
+    std::set<uint32_t> done;
+    for (NodeContainer::Iterator d = destinations.Begin();
+         d != destinations.End(); d++) {
+      std::map<uint32_t, size_t>::const_iterator it =
+          m_indexOf.find((*d)->GetId());
+      if (it != m_indexOf.end() && done.insert(it->second).second) {
+        RoutesTo(it->second);
+      }
+    }
+  }
+
+  /* Every node to every other one; O(N^2) routes. */
+  void Install(NetDeviceContainer devices) {
+    NodeContainer all;
+    for (NetDeviceContainer::Iterator i = devices.Begin(); i != devices.End();
+         i++) {
+      all.Add((*i)->GetNode());
+    }
+    Install(devices, all);
+  }
+
+  /* Neighbour pairs (each direction counted once) of the last Install(). */
+  uint64_t GetLinkCount() const { return m_links; }
+
+  /* Host routes added by the last Install(). */
+  uint64_t GetRouteCount() const { return m_routes; }
+
+  /* Source/destination pairs without any path. */
+  uint64_t GetUnreachableCount() const { return m_unreachable; }
+
+private:
+  struct Neighbour {
+    size_t index;
+    double rxDbm; // Power at which the neighbour hears us
+  };
+
+  struct Station {
+    Ptr<WifiNetDevice> device;
+    Ptr<MobilityModel> mobility;
+    double txDbm;
+    double rxGain;
+    double threshold;
+    Ptr<Ipv4StaticRouting> routing;
+    uint32_t interface;
+    Ipv4Address address;
+    std::vector<Neighbour> neighbours;
+  };
+
+  void BuildGraph(NetDeviceContainer devices) {
+    m_stations.clear();
+    m_indexOf.clear();
+    m_links = m_routes = m_unreachable = 0;
+    Ipv4StaticRoutingHelper staticRouting;
+    for (NetDeviceContainer::Iterator i = devices.Begin(); i != devices.End();
+         i++) {
+      Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>(*i);
+      if (dev == 0) {
+        continue;
+      }
+      Ptr<Node> node = dev->GetNode();
+      Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+      Ptr<MobilityModel> mm = node->GetObject<MobilityModel>();
+      NS_ABORT_MSG_IF(ipv4 == 0 || mm == 0,
+                      "StaticMeshRoutingHelper needs IPv4 and mobility");
+      Ptr<WifiPhy> phy = dev->GetPhy();
+      DoubleValue ed;
+      phy->GetAttribute("EnergyDetectionThreshold", ed);
+      Station s;
+      s.device = dev;
+      s.mobility = mm;
+      s.txDbm = phy->GetTxPowerEnd() + phy->GetTxGain();
+      s.rxGain = phy->GetRxGain();
+      s.threshold = ed.Get();
+      s.routing = staticRouting.GetStaticRouting(ipv4);
+      NS_ABORT_MSG_IF(s.routing == 0, "Node " << node->GetId()
+                                              << " has no Ipv4StaticRouting");
+      int32_t interface = ipv4->GetInterfaceForDevice(dev);
+      NS_ABORT_MSG_IF(interface < 0, "Device without IPv4 interface");
+      s.interface = interface;
+      s.address = ipv4->GetAddress(interface, 0).GetLocal();
+      m_indexOf[node->GetId()] = m_stations.size();
+      m_stations.push_back(s);
+    }
+
+    // Bound the range with the most sensitive receiver at the highest z,
+    // once per transmit power level.
+    double threshold = INFINITY, rxGain = -INFINITY, z = 0;
+    for (size_t i = 0; i < m_stations.size(); i++) {
+      threshold = std::min(threshold, m_stations[i].threshold);
+      rxGain = std::max(rxGain, m_stations[i].rxGain);
+      z = std::max(z, m_stations[i].mobility->GetPosition().z);
+    }
+    std::map<double, double> rangeOf;
+    double range = 1;
+    for (size_t i = 0; i < m_stations.size(); i++) {
+      double tx = m_stations[i].txDbm;
+      if (rangeOf.find(tx) == rangeOf.end()) {
+        rangeOf[tx] = MaxRadioRange(m_loss, tx + rxGain, threshold, z);
+        range = std::max(range, rangeOf[tx]);
+      }
+    }
+    RangeGrid grid(range);
+    for (size_t i = 0; i < m_stations.size(); i++) {
+      grid.Add(m_stations[i].mobility->GetPosition());
+    }
+
+    for (size_t i = 0; i < m_stations.size(); i++) {
+      grid.ForEachCandidate(i, [&](size_t j) {
+        double there, back;
+        if (j < i || !Hears(i, j, there) || !Hears(j, i, back)) {
+          return;
+        }
+        Neighbour toJ = {j, there};
+        Neighbour toI = {i, back};
+        m_stations[i].neighbours.push_back(toJ);
+        m_stations[j].neighbours.push_back(toI);
+        m_links++;
+      });
+    }
+  }
+
+  /* Whether `to` decodes frames from `from`; `rxDbm` is the power. */
+  bool Hears(size_t from, size_t to, double &rxDbm) const {
+    const Station &a = m_stations[from];
+    const Station &b = m_stations[to];
+    rxDbm = m_loss->CalcRxPower(a.txDbm, a.mobility, b.mobility) + b.rxGain;
+    return rxDbm >= b.threshold;
+  }
+
+  /* Breadth-first search from `dst`; parents are next hops towards it. */
+  void RoutesTo(size_t dst) {
+    std::vector<int64_t> hops(m_stations.size(), -1);
+    std::vector<size_t> order(1, dst);
+    hops[dst] = 0;
+    for (size_t q = 0; q < order.size(); q++) {
+      const std::vector<Neighbour> &nb = m_stations[order[q]].neighbours;
+      for (size_t k = 0; k < nb.size(); k++) {
+        if (hops[nb[k].index] < 0) {
+          hops[nb[k].index] = hops[order[q]] + 1;
+          order.push_back(nb[k].index);
+        }
+      }
+    }
+    m_unreachable += m_stations.size() - order.size();
+
+    const Station &target = m_stations[dst];
+    for (size_t q = 1; q < order.size(); q++) {
+      Station &s = m_stations[order[q]];
+      const Neighbour *best = nullptr;
+      for (size_t k = 0; k < s.neighbours.size(); k++) {
+        const Neighbour &n = s.neighbours[k];
+        if (hops[n.index] == hops[order[q]] - 1 &&
+            (best == nullptr || n.rxDbm > best->rxDbm)) {
+          best = &n;
+        }
+      }
+      s.routing->AddHostRouteTo(target.address,
+                                m_stations[best->index].address, s.interface);
+      m_routes++;
+    }
+  }
+
+  Ptr<PropagationLossModel> m_loss;
+  std::vector<Station> m_stations;
+  std::map<uint32_t, size_t> m_indexOf; // Node id -> m_stations index
+  uint64_t m_links;
+  uint64_t m_routes;
+  uint64_t m_unreachable;
+};
+
+} // namespace ns3
+
+#endif /* STATIC_MESH_ROUTING_H */
@@ -0,0 +1,348 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SWEEP_POOL_H
+#define SWEEP_POOL_H
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+/*
+ * Bounded process pool used by the sweep tools in scratch/. Every job is one
+ * already-built scenario binary that is fork()ed and exec()ed directly, so no
+ * waf dependency check is paid per run. At most `workers` jobs run at once;
+ * with pinning enabled every worker slot is bound to its own CPU taken from
+ * the affinity mask the pool was started with.
+ *
+ * The pool does not own a job queue: callers launch jobs while a slot is free
+ * and collect them with WaitAny(), which lets drivers decide what to run next
+ * from the results they have seen so far.
+ */
+
+/* One scenario invocation. */
+struct SweepJob {
+  std::string id;                // Free-form label, e.g. "nWifi=3 packetSize=300"
+  std::vector<std::string> argv; // argv[0] is the program path
+  std::string logPath;           // stdout and stderr of the run, "" for none
+  size_t tag = 0;                // Caller-defined index, returned unchanged
+};
+
+/* Outcome of one finished job. */
+struct SweepResult {
+  size_t tag = 0;
+  int status = -1;           // Exit code, or -signal when killed by a signal
+  double wallSeconds = 0;    // Wall-clock time from fork to reap
+  long maxRssKb = 0;         // Peak resident set size of the child
+  int cpu = -1;              // CPU the job was pinned to, -1 when unpinned
+};
+
+class SweepPool {
+public:
+  SweepPool(unsigned workers, bool pin) : m_pin(pin) {
+    if (workers == 0) {
+      long n = sysconf(_SC_NPROCESSORS_ONLN);
+      workers = n > 0 ? n : 1;
+    }
+    m_slots.resize(workers);
+
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+      for (int c = 0; c < CPU_SETSIZE; c++) {
+        if (CPU_ISSET(c, &mask)) {
+          m_cpus.push_back(c);
+        }
+      }
+    }
+  }
+
+  unsigned Workers() const { return m_slots.size(); }
+
+  size_t Running() const {
+    size_t n = 0;
+    for (size_t i = 0; i < m_slots.size(); i++) {
+      n += m_slots[i].pid > 0;
+    }
+    return n;
+  }
+
+  bool HasFreeSlot() const { return Running() < m_slots.size(); }
+
+  /* Start `job` in a free slot. Returns false if fork() failed or the pool is
+   * full; the job is then not running and will not be reported. */
+  bool Launch(const SweepJob &job) {
+    size_t slot = 0;
+    while (slot < m_slots.size() && m_slots[slot].pid > 0) {
+      slot++;
+    }
+    if (slot == m_slots.size() || job.argv.empty()) {
+      return false;
+    }
+
+    int cpu = -1;
+    if (m_pin && !m_cpus.empty()) {
+      cpu = m_cpus[slot % m_cpus.size()];
+    }
+
+    // Build argv before forking so the child only calls async-signal-safe
+    // functions.
+    std::vector<char *> args;
+    for (size_t i = 0; i < job.argv.size(); i++) {
+      args.push_back(const_cast<char *>(job.argv[i].c_str()));
+    }
+    args.push_back(nullptr);
+
+    Slot &s = m_slots[slot];
+    s.start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0) {
+      return false;
+    }
+    if (pid == 0) {
+      if (cpu >= 0) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpu, &mask);
+        sched_setaffinity(0, sizeof(mask), &mask);
+      }
+      if (!job.logPath.empty()) {
+        int fd = open(job.logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+          dup2(fd, STDOUT_FILENO);
+          dup2(fd, STDERR_FILENO);
+          close(fd);
+        }
+      }
+      execv(args[0], args.data());
+      _exit(127);
+    }
+    s.pid = pid;
+    s.tag = job.tag;
+    s.cpu = cpu;
+    return true;
+  }
+
+  /* Block until any running job exits. Returns false if nothing is running. */
+  bool WaitAny(SweepResult &result) {
+    if (Running() == 0) {
+      return false;
+    }
+    for (;;) {
+      int status = 0;
+      struct rusage usage;
+      pid_t pid = wait4(-1, &status, 0, &usage);
+      if (pid < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+      for (size_t i = 0; i < m_slots.size(); i++) {
+        Slot &s = m_slots[i];
+        if (s.pid != pid) {
+          continue;
+        }
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - s.start;
+        result.tag = s.tag;
+        result.cpu = s.cpu;
+        result.wallSeconds = elapsed.count();
+        result.maxRssKb = usage.ru_maxrss;
+        if (WIFEXITED(status)) {
+          result.status = WEXITSTATUS(status);
+        } else if (WIFSIGNALED(status)) {
+          result.status = -WTERMSIG(status);
+        } else {
+          result.status = -1;
+        }
+        s.pid = 0;
+        return true;
+      }
+      // Not one of ours (should not happen), keep waiting.
+    }
+  }
+
+private:
+  struct Slot {
+    pid_t pid = 0;
+    size_t tag = 0;
+    int cpu = -1;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  bool m_pin;
+  std::vector<Slot> m_slots;
+  std::vector<int> m_cpus;
+};
+
+/* Split `s` at every `sep`, dropping empty fields. */
+inline std::vector<std::string> SweepSplit(const std::string &s, char sep) {
+  std::vector<std::string> out;
+  std::string::size_type start = 0;
+  while (start <= s.size()) {
+    std::string::size_type end = s.find(sep, start);
+    if (end == std::string::npos) {
+      end = s.size();
+    }
+    if (end > start) {
+      out.push_back(s.substr(start, end - start));
+    }
+    start = end + 1;
+  }
+  return out;
+}
+
+/* Split a command-line fragment at whitespace, honouring double quotes. */
+inline std::vector<std::string> SweepSplitArgs(const std::string &s) {
+  std::vector<std::string> out;
+  std::string cur;
+  bool quoted = false, any = false;
+  for (size_t i = 0; i < s.size(); i++) {
+    char c = s[i];
+    if (c == '"') {
+      quoted = !quoted;
+      any = true;
+    } else if (!quoted && (c == ' ' || c == '\t' || c == '\n')) {
+      if (any) {
+        out.push_back(cur);
+      }
+      cur.clear();
+      any = false;
+    } else {
+      cur += c;
+      any = true;
+    }
+  }
+  if (any) {
+    out.push_back(cur);
+  }
+  return out;
+}
+
+/* Numeric "key=value" pairs of the last record in `path`, in record order. */
+inline bool SweepReadRecord(const std::string &path,
+                            std::vector<std::pair<std::string, double>> &out) {
+  std::ifstream in(path.c_str());
+  std::string line, last;
+  while (std::getline(in, line)) {
+    if (!line.empty()) {
+      last = line;
+    }
+  }
+  if (last.empty()) {
+    return false;
+  }
+  std::istringstream fields(last);
+  std::string field;
+  while (fields >> field) {
+    std::string::size_type eq = field.find('=');
+    if (eq == std::string::npos) {
+      continue;
+    }
+    std::string value = field.substr(eq + 1);
+    char *end = nullptr;
+    double x = strtod(value.c_str(), &end);
+    if (!value.empty() && *end == '\0' && std::isfinite(x)) {
+      out.push_back(std::make_pair(field.substr(0, eq), x));
+    }
+  }
+  return true;
+}
+
+/* Create `dir` and its parents. */
+inline void SweepMakeDirs(const std::string &dir) {
+  for (std::string::size_type pos = dir.find('/', 1);;
+       pos = dir.find('/', pos + 1)) {
+    mkdir(dir.substr(0, pos).c_str(), 0755);
+    if (pos == std::string::npos) {
+      break;
+    }
+  }
+}
+
+/*
+ * Regular files belonging to the output path `out`, modified at or after
+ * `since`: everything below it when it is a directory, otherwise every file
+ * whose path starts with it (a pcap or trace prefix). Sorted by path.
+ */
+inline std::vector<std::string> SweepOutputFiles(const std::string &out,
+                                                 time_t since) {
+  std::vector<std::string> files;
+  if (out.empty()) {
+    return files;
+  }
+  struct stat st;
+  std::vector<std::pair<std::string, std::string>> dirs; // dir, name prefix
+  if (stat(out.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+    dirs.push_back(std::make_pair(out, ""));
+  } else {
+    std::string::size_type slash = out.rfind('/');
+    dirs.push_back(slash == std::string::npos
+                       ? std::make_pair(std::string("."), out)
+                       : std::make_pair(out.substr(0, slash),
+                                        out.substr(slash + 1)));
+  }
+  while (!dirs.empty()) {
+    std::pair<std::string, std::string> d = dirs.back();
+    dirs.pop_back();
+    DIR *dir = opendir(d.first.c_str());
+    if (dir == nullptr) {
+      continue;
+    }
+    while (struct dirent *e = readdir(dir)) {
+      std::string name = e->d_name;
+      if (name == "." || name == ".." ||
+          name.compare(0, d.second.size(), d.second) != 0) {
+        continue;
+      }
+      std::string path = d.first == "." && out.find('/') == std::string::npos
+                             ? name
+                             : d.first + "/" + name;
+      if (stat(path.c_str(), &st) != 0) {
+        continue;
+      }
+      if (S_ISDIR(st.st_mode)) {
+        dirs.push_back(std::make_pair(path, ""));
+      } else if (S_ISREG(st.st_mode) && st.st_mtime >= since) {
+        files.push_back(path);
+      }
+    }
+    closedir(dir);
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+#endif /* SWEEP_POOL_H */
@@ -0,0 +1,386 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/core-module.h"
+#include "result-cache.h"
+#include "sweep-pool.h"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <sys/stat.h>
+
+/*
+ * Runs an already-built scenario binary over the cartesian product of a
+ * parameter grid in a bounded worker pool, e.g.
+ *
+ *   build/scratch/sweep --program=build/scratch/LAB3adhoc \
+ *     --grid="nWifi=6,5,4,3;packetSize=300,700,1200" \
+ *     --output="results/nSta-{nWifi}-pktSize-{packetSize}-node" \
+ *     --manifest=results/lab3/manifest.csv
+ *
+ * Every grid point becomes one "--name=value" argument per dimension. The
+ * --args and --output strings may reference grid values as {name} and the
+ * job index as {id}. A value written as "value@label" is passed as `value`
+ * but expands {name.label} to `label`, e.g. for short output directories.
+ * Exit status, timings and output paths of all jobs end up in a single CSV
+ * manifest.
+ *
+ * With --cache=<file.db>, successful runs are kept in an SQLite store (see
+ * result-cache.h) together with their log and every file under their
+ * expanded --output path. A configuration found in the store is not
+ * simulated again; its files and log are written back instead and the
+ * manifest marks it as cached.
+ */
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("SWEEP");
+
+namespace {
+
+struct Dimension {
+  std::string name;
+  std::vector<std::string> values;
+  std::vector<std::string> labels;
+};
+
+std::string Expand(std::string s, const std::map<std::string, std::string> &vars) {
+  for (std::map<std::string, std::string>::const_iterator i = vars.begin();
+       i != vars.end(); i++) {
+    std::string key = "{" + i->first + "}";
+    std::string::size_type pos = 0;
+    while ((pos = s.find(key, pos)) != std::string::npos) {
+      s.replace(pos, key.size(), i->second);
+      pos += i->second.size();
+    }
+  }
+  return s;
+}
+
+std::string CsvQuote(const std::string &s) {
+  std::string out = "\"";
+  for (size_t i = 0; i < s.size(); i++) {
+    if (s[i] == '"') {
+      out += '"';
+    }
+    out += s[i];
+  }
+  return out + "\"";
+}
+
+/*
+ * Everything that decides the outcome of `job`: the build IDs of the binary
+ * and the ns-3 libraries, its arguments (which carry the seed and run when
+ * they are set), the environment ns-3 reads attribute and global value
+ * defaults from, and the contents of any ConfigStore input file named there.
+ */
+std::string ResultCacheConfig(const SweepJob &job,
+                              const std::string &buildIds) {
+  std::ostringstream config;
+  config << buildIds;
+  for (size_t a = 1; a < job.argv.size(); a++) {
+    config << "arg " << job.argv[a] << "\n";
+  }
+  const char *vars[] = {"NS_ATTRIBUTE_DEFAULT", "NS_GLOBAL_VALUE", "NS_LOG"};
+  std::vector<std::string> sources(job.argv.begin() + 1, job.argv.end());
+  for (size_t v = 0; v < sizeof(vars) / sizeof(vars[0]); v++) {
+    const char *value = getenv(vars[v]);
+    config << "env " << vars[v] << "=" << (value ? value : "") << "\n";
+    if (value != nullptr) {
+      sources.push_back(value);
+    }
+  }
+  const std::string store = "ConfigStore::Filename=";
+  for (size_t i = 0; i < sources.size(); i++) {
+    std::string::size_type pos = sources[i].find(store);
+    if (pos == std::string::npos) {
+      continue;
+    }
+    std::string file = sources[i].substr(pos + store.size());
+    file = file.substr(0, file.find('|'));
+    std::string data;
+    config << "configstore " << file << " "
+           << (ResultCacheReadFile(file, data) ? ResultCacheHash(data)
+                                               : "missing")
+           << "\n";
+  }
+  return config.str();
+}
+
+/* Build IDs of the program and of every ns-3 library in `libPath`. */
+std::string BuildIds(const std::string &program, const std::string &libPath) {
+  std::string ids = "program " + ResultCacheFileId(program) + "\n";
+  std::vector<std::string> libs;
+  std::vector<std::string> dirs = SweepSplit(libPath, ':');
+  for (size_t d = 0; d < dirs.size(); d++) {
+    DIR *dir = opendir(dirs[d].c_str());
+    while (dir != nullptr) {
+      struct dirent *e = readdir(dir);
+      if (e == nullptr) {
+        closedir(dir);
+        break;
+      }
+      std::string name = e->d_name;
+      if (name.compare(0, 6, "libns3") == 0 &&
+          name.find(".so") != std::string::npos) {
+        libs.push_back(dirs[d] + "/" + name);
+      }
+    }
+  }
+  std::sort(libs.begin(), libs.end());
+  for (size_t i = 0; i < libs.size(); i++) {
+    ids += "lib " + libs[i] + " " + ResultCacheFileId(libs[i]) + "\n";
+  }
+  return ids;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string program;
+  std::string grid;
+  std::string extraArgs;
+  std::string output;
+  std::string manifestPath("results/manifest.csv");
+  std::string logDir("results/logs");
+  std::string libPath("build/lib");
+  uint32_t jobs = 0;
+  bool pin = false;
+  std::string cachePath;
+
+  CommandLine cmd;
+  cmd.AddValue("program", "Path of the built scenario binary", program);
+  cmd.AddValue("grid", "Parameter grid, \"name=v1,v2;name=v1,v2\"", grid);
+  cmd.AddValue("args", "Extra arguments passed to every run", extraArgs);
+  cmd.AddValue("output", "Output path (file prefix or directory) of each run, "
+                         "recorded in the manifest and cached",
+               output);
+  cmd.AddValue("manifest", "CSV manifest written after the sweep", manifestPath);
+  cmd.AddValue("logDir", "Directory for per-run stdout/stderr logs", logDir);
+  cmd.AddValue("libPath", "Prepended to LD_LIBRARY_PATH for the runs", libPath);
+  cmd.AddValue("jobs", "Concurrent runs, 0 = one per online CPU", jobs);
+  cmd.AddValue("pin", "Pin every worker slot to its own CPU", pin);
+  cmd.AddValue("cache", "SQLite file of earlier results, \"\" to always run",
+               cachePath);
+  cmd.Parse(argc, argv);
+
+  if (program.empty()) {
+    std::cerr << "--program is required" << std::endl;
+    return 1;
+  }
+
+  if (!libPath.empty()) {
+    const char *old = getenv("LD_LIBRARY_PATH");
+    std::string value = libPath;
+    if (old != nullptr && *old != '\0') {
+      value += ":" + std::string(old);
+    }
+    setenv("LD_LIBRARY_PATH", value.c_str(), 1);
+  }
+  if (!logDir.empty()) {
+    mkdir(logDir.c_str(), 0755);
+  }
+
+  std::vector<Dimension> dims;
+  std::vector<std::string> axes = SweepSplit(grid, ';');
+  for (size_t i = 0; i < axes.size(); i++) {
+    std::string::size_type eq = axes[i].find('=');
+    if (eq == std::string::npos) {
+      std::cerr << "Malformed grid dimension: " << axes[i] << std::endl;
+      return 1;
+    }
+    Dimension d;
+    d.name = axes[i].substr(0, eq);
+    std::vector<std::string> values = SweepSplit(axes[i].substr(eq + 1), ',');
+    for (size_t v = 0; v < values.size(); v++) {
+      std::string::size_type at = values[v].find('@');
+      d.values.push_back(values[v].substr(0, at));
+      d.labels.push_back(at == std::string::npos ? values[v]
+                                                 : values[v].substr(at + 1));
+    }
+    if (d.values.empty()) {
+      std::cerr << "Grid dimension without values: " << d.name << std::endl;
+      return 1;
+    }
+    dims.push_back(d);
+  }
+
+  // Enumerate the cartesian product, last dimension varying fastest.
+  std::vector<SweepJob> sweep;
+  std::vector<std::string> outputs;
+  std::vector<size_t> index(dims.size(), 0);
+  for (;;) {
+    std::map<std::string, std::string> vars;
+    SweepJob job;
+    job.tag = sweep.size();
+    vars["id"] = std::to_string(job.tag);
+    job.argv.push_back(program);
+    for (size_t d = 0; d < dims.size(); d++) {
+      const std::string &value = dims[d].values[index[d]];
+      vars[dims[d].name] = value;
+      vars[dims[d].name + ".label"] = dims[d].labels[index[d]];
+      job.argv.push_back("--" + dims[d].name + "=" + value);
+      job.id += (d ? " " : "") + dims[d].name + "=" + value;
+    }
+    std::vector<std::string> extra = SweepSplitArgs(Expand(extraArgs, vars));
+    job.argv.insert(job.argv.end(), extra.begin(), extra.end());
+    if (!logDir.empty()) {
+      job.logPath = logDir + "/run-" + vars["id"] + ".log";
+    }
+    sweep.push_back(job);
+    outputs.push_back(Expand(output, vars));
+
+    size_t d = dims.size();
+    while (d > 0 && ++index[d - 1] == dims[d - 1].values.size()) {
+      index[--d] = 0;
+    }
+    if (d == 0) {
+      break;
+    }
+  }
+
+  std::vector<SweepResult> results(sweep.size());
+  std::vector<bool> launched(sweep.size(), false);
+  std::vector<bool> cached(sweep.size(), false);
+  size_t failed = 0;
+
+  // Serve what the store already has before starting any worker.
+  ResultCache cache;
+  std::vector<std::string> configs(sweep.size());
+  std::vector<time_t> started(sweep.size(), 0);
+  if (!cachePath.empty()) {
+    std::string error;
+    if (!cache.Open(cachePath, error)) {
+      std::cerr << "Cannot open cache " << cachePath << ": " << error
+                << std::endl;
+      return 1;
+    }
+    std::string buildIds = BuildIds(program, libPath);
+    for (size_t i = 0; i < sweep.size(); i++) {
+      configs[i] = ResultCacheConfig(sweep[i], buildIds);
+      CachedRun run;
+      if (!cache.Lookup(ResultCacheHash(configs[i]), configs[i], run)) {
+        continue;
+      }
+      if (!ResultCache::Restore(run)) {
+        std::cerr << "[" << i << "] " << sweep[i].id
+                  << ": cannot restore cached files, running again"
+                  << std::endl;
+        continue;
+      }
+      if (!sweep[i].logPath.empty()) {
+        std::ofstream log(sweep[i].logPath.c_str(), std::ios::binary);
+        log << run.log;
+      }
+      cached[i] = true;
+      results[i].tag = i;
+      results[i].status = run.status;
+      results[i].wallSeconds = run.wallSeconds;
+      results[i].maxRssKb = run.maxRssKb;
+    }
+  }
+
+  size_t hits = std::count(cached.begin(), cached.end(), true);
+  SweepPool pool(jobs, pin);
+  std::cout << "Running " << sweep.size() - hits << " configurations of "
+            << program << " on " << pool.Workers() << " workers";
+  if (hits > 0) {
+    std::cout << ", " << hits << " served from " << cachePath;
+  }
+  std::cout << std::endl;
+
+  size_t next = 0;
+  while (next < sweep.size() || pool.Running() > 0) {
+    while (next < sweep.size() && pool.HasFreeSlot()) {
+      if (cached[next]) {
+        next++;
+        continue;
+      }
+      started[next] = time(nullptr);
+      if (pool.Launch(sweep[next])) {
+        launched[next] = true;
+      } else {
+        failed++;
+        std::cerr << "[" << sweep[next].tag << "] " << sweep[next].id
+                  << ": fork failed" << std::endl;
+      }
+      next++;
+    }
+    SweepResult r;
+    if (!pool.WaitAny(r)) {
+      continue;
+    }
+    results[r.tag] = r;
+    failed += r.status != 0;
+    std::cout << "[" << r.tag << "] " << sweep[r.tag].id << ": exit "
+              << r.status << " in " << r.wallSeconds << " s" << std::endl;
+
+    // Only successful runs are worth serving again.
+    if (!cachePath.empty() && r.status == 0) {
+      CachedRun run;
+      run.status = r.status;
+      run.wallSeconds = r.wallSeconds;
+      run.maxRssKb = r.maxRssKb;
+      if (!sweep[r.tag].logPath.empty()) {
+        ResultCacheReadFile(sweep[r.tag].logPath, run.log);
+      }
+      std::vector<std::string> files =
+          SweepOutputFiles(outputs[r.tag], started[r.tag]);
+      for (size_t f = 0; f < files.size(); f++) {
+        std::string data;
+        if (ResultCacheReadFile(files[f], data)) {
+          run.files.push_back(std::make_pair(files[f], data));
+        }
+      }
+      if (!cache.Store(ResultCacheHash(configs[r.tag]), configs[r.tag],
+                       run)) {
+        std::cerr << "[" << r.tag << "] cannot store result in " << cachePath
+                  << std::endl;
+      }
+    }
+  }
+  cache.Close();
+
+  std::ofstream manifest(manifestPath.c_str());
+  if (!manifest) {
+    std::cerr << "Cannot write manifest " << manifestPath << std::endl;
+    return 1;
+  }
+  manifest << "id,config,status,wall_s,max_rss_kb,cpu,log,output,command,"
+              "cached\n";
+  for (size_t i = 0; i < sweep.size(); i++) {
+    std::string command;
+    for (size_t a = 0; a < sweep[i].argv.size(); a++) {
+      command += (a ? " " : "") + sweep[i].argv[a];
+    }
+    const SweepResult &r = results[i];
+    manifest << i << "," << CsvQuote(sweep[i].id) << ","
+             << (launched[i] || cached[i] ? r.status : -1) << ","
+             << r.wallSeconds << ","
+             << r.maxRssKb << "," << r.cpu << "," << CsvQuote(sweep[i].logPath)
+             << "," << CsvQuote(outputs[i]) << "," << CsvQuote(command) << ","
+             << (cached[i] ? 1 : 0) << "\n";
+  }
+
+  std::cout << sweep.size() - failed << "/" << sweep.size()
+            << " runs succeeded, manifest: " << manifestPath << std::endl;
+  return failed ? 1 : 0;
+}
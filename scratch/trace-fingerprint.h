@@ -0,0 +1,246 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TRACE_FINGERPRINT_H
+#define TRACE_FINGERPRINT_H
+
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "run-record.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * Hash of the observable event stream of a run, for checking that a faster
+ * model or channel gives the same results as the reference one.
+ *
+ * Every traced event contributes its kind, the trace path it came from (so
+ * the node and device), the packet size and the time it happened. Events of
+ * the same instant are combined order-independently, because the order of
+ * simultaneous events depends on how many other events were scheduled and
+ * says nothing about the results; instants are then folded into the hash in
+ * time order (64-bit FNV-1a).
+ *
+ * Only outcomes are traced: PHY transmissions and successful receptions, MAC
+ * drops and application receptions. PhyRxDrop is left out on purpose, since
+ * frames far below the detection threshold are exactly what the spatial
+ * channel avoids delivering.
+ *
+ * Besides the total, a hash per `window` of simulated time is kept. Writing
+ * both runs' windows with WriteWindows() and diffing them shows when two runs
+ * start to differ.
+ */
+class TraceFingerprint {
+public:
+  enum Kind { PHY_TX, PHY_RX, MAC_DROP, APP_RX, KINDS };
+
+  explicit TraceFingerprint(Time window = Seconds(1))
+      : m_window(window.GetTimeStep()), m_total(kOffset), m_instant(-1),
+        m_instantSum(0), m_instantEvents(0), m_windowStart(0),
+        m_windowHash(kOffset), m_windowEvents(0) {
+    for (int k = 0; k < KINDS; k++) {
+      m_counts[k] = 0;
+    }
+  }
+
+  /* PHY TX begin / RX end and MAC drops of every Wi-Fi device. */
+  void ConnectWifi() {
+    const std::string dev = "/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/";
+    Connect(dev + "Phy/PhyTxBegin", PHY_TX);
+    Connect(dev + "Phy/PhyRxEnd", PHY_RX);
+    Connect(dev + "Mac/MacTxDrop", MAC_DROP);
+    Connect(dev + "Mac/MacRxDrop", MAC_DROP);
+  }
+
+  /* Point-to-point links, e.g. the EPC backhaul of the LTE scenario. */
+  void ConnectPointToPoint() {
+    const std::string dev =
+        "/NodeList/*/DeviceList/*/$ns3::PointToPointNetDevice/";
+    Connect(dev + "PhyTxBegin", PHY_TX);
+    Connect(dev + "PhyRxEnd", PHY_RX);
+    Connect(dev + "MacTxDrop", MAC_DROP);
+    Connect(dev + "PhyRxDrop", MAC_DROP);
+  }
+
+  /* Transport blocks decoded by LTE UEs and eNBs. */
+  void ConnectLte() {
+    Connect("/NodeList/*/DeviceList/*/$ns3::LteUeNetDevice/"
+            "ComponentCarrierMapUe/*/LteUePhy/DlSpectrumPhy/RxEndOk",
+            PHY_RX);
+    Connect("/NodeList/*/DeviceList/*/$ns3::LteEnbNetDevice/"
+            "ComponentCarrierMap/*/LteEnbPhy/UlSpectrumPhy/RxEndOk",
+            PHY_RX);
+  }
+
+  /* The "Rx" trace of every application in `sinks` (e.g. CountingSinks). */
+  void ConnectApps(const ApplicationContainer &sinks) {
+    for (uint32_t i = 0; i < sinks.GetN(); i++) {
+      sinks.Get(i)->TraceConnect(
+          "Rx", "app/" + std::to_string(i),
+          MakeCallback(&TraceFingerprint::AppRx, this));
+    }
+  }
+
+  /*
+   * "fingerprint" (16 hex digits), "fp_events" and the number of events of
+   * every kind. Call once, after Simulator::Run().
+   */
+  void Record(RunRecord &record) {
+    Flush(-1);
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)m_total);
+    record.Add("fingerprint", hex);
+    uint64_t events = 0;
+    for (int k = 0; k < KINDS; k++) {
+      events += m_counts[k];
+    }
+    record.Add("fp_events", events);
+    record.Add("fp_phy_tx", m_counts[PHY_TX]);
+    record.Add("fp_phy_rx", m_counts[PHY_RX]);
+    record.Add("fp_mac_drop", m_counts[MAC_DROP]);
+    record.Add("fp_app_rx", m_counts[APP_RX]);
+  }
+
+  /* "<start [s]> <hash> <events>" per non-empty window ("-" = stdout). */
+  void WriteWindows(const std::string &path) {
+    Flush(-1);
+    std::ofstream file;
+    if (path != "-") {
+      file.open(path.c_str());
+    }
+    std::ostream &out = path == "-" ? std::cout : file;
+    for (size_t i = 0; i < m_windows.size(); i++) {
+      char line[96];
+      snprintf(line, sizeof(line), "%.6f %016llx %llu\n",
+               TimeStep(m_windows[i].start).GetSeconds(),
+               (unsigned long long)m_windows[i].hash,
+               (unsigned long long)m_windows[i].events);
+      out << line;
+    }
+  }
+
+private:
+  static const uint64_t kOffset = 14695981039346656037ULL;
+  static const uint64_t kPrime = 1099511628211ULL;
+
+  struct Window {
+    int64_t start; // [time steps]
+    uint64_t hash;
+    uint64_t events;
+  };
+
+  static uint64_t Fnv(uint64_t h, const void *data, size_t size) {
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++) {
+      h = (h ^ p[i]) * kPrime;
+    }
+    return h;
+  }
+
+  /* splitmix64 finaliser, so that summing event hashes stays well mixed. */
+  static uint64_t Mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  void Connect(const std::string &path, Kind kind) {
+    void (TraceFingerprint::*handler)(std::string, Ptr<const Packet>) =
+        kind == PHY_TX   ? &TraceFingerprint::PhyTx
+        : kind == PHY_RX ? &TraceFingerprint::PhyRx
+                         : &TraceFingerprint::MacDrop;
+    Config::Connect(path, MakeCallback(handler, this));
+  }
+
+  void PhyTx(std::string context, Ptr<const Packet> p) {
+    Add(PHY_TX, context, p->GetSize());
+  }
+
+  void PhyRx(std::string context, Ptr<const Packet> p) {
+    Add(PHY_RX, context, p->GetSize());
+  }
+
+  void MacDrop(std::string context, Ptr<const Packet> p) {
+    Add(MAC_DROP, context, p->GetSize());
+  }
+
+  void AppRx(std::string context, Ptr<const Packet> p, const Address &from) {
+    Add(APP_RX, context, p->GetSize());
+  }
+
+  void Add(Kind kind, const std::string &context, uint32_t size) {
+    int64_t now = Simulator::Now().GetTimeStep();
+    if (now != m_instant) {
+      Flush(now);
+    }
+    uint8_t k = kind;
+    uint64_t h = Fnv(kOffset, &k, sizeof(k));
+    h = Fnv(h, context.data(), context.size());
+    h = Fnv(h, &size, sizeof(size));
+    m_instantSum += Mix(h);
+    m_instantEvents++;
+    m_counts[kind]++;
+  }
+
+  /*
+   * Fold the current instant into the total and window hashes and move on to
+   * `next`; -1 closes the open window as well.
+   */
+  void Flush(int64_t next) {
+    if (m_instantEvents > 0) {
+      uint64_t words[3] = {uint64_t(m_instant), m_instantSum, m_instantEvents};
+      m_total = Fnv(m_total, words, sizeof(words));
+      m_windowHash = Fnv(m_windowHash, words, sizeof(words));
+      m_windowEvents += m_instantEvents;
+    }
+    m_instantSum = 0;
+    m_instantEvents = 0;
+    m_instant = next;
+    if (next >= 0 && next < m_windowStart + m_window) {
+      return;
+    }
+    if (m_windowEvents > 0) {
+      Window w = {m_windowStart, m_windowHash, m_windowEvents};
+      m_windows.push_back(w);
+    }
+    m_windowHash = kOffset;
+    m_windowEvents = 0;
+    if (next >= 0) {
+      m_windowStart = next - next % m_window;
+    }
+  }
+
+  int64_t m_window;
+  uint64_t m_total;
+  int64_t m_instant; // Time of the events in m_instantSum, -1 for none
+  uint64_t m_instantSum;
+  uint64_t m_instantEvents;
+  int64_t m_windowStart;
+  uint64_t m_windowHash;
+  uint64_t m_windowEvents;
+  std::vector<Window> m_windows;
+  uint64_t m_counts[KINDS];
+};
+
+} // namespace ns3
+
+#endif /* TRACE_FINGERPRINT_H */
@@ -0,0 +1,163 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TRAJECTORY_STATS_H
+#define TRAJECTORY_STATS_H
+
+#include "ns3/core-module.h"
+#include "ns3/lte-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/network-module.h"
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <string>
+
+namespace ns3 {
+
+/*
+ * Downlink throughput, SINR and MCS of one moving UE, binned by the distance
+ * it has travelled, so that a single run along a path gives the whole
+ * throughput-over-position curve.
+ *
+ * From `start` on (i.e. once attach and bearer setup are over) every event
+ * is put in the bin of the UE's position at that moment: bytes received by
+ * the sink, the UE PHY's RSRP/SINR reports (one per
+ * LteUePhy::RsrpSinrSamplePeriod) and the MCS of every transport block the
+ * eNB MAC schedules for it. A bin spans from its first to its last event;
+ * the throughput is its bytes over that time, so bins must be crossed in a
+ * good number of SINR periods.
+ */
+class TrajectoryStats {
+public:
+  TrajectoryStats(Ptr<MobilityModel> ue, Ptr<MobilityModel> enb,
+                  double binWidth, Time start)
+      : m_ue(ue), m_enb(enb), m_binWidth(binWidth), m_start(start) {}
+
+  /* The "Rx" trace of the UE's sink (a PacketSink or CountingSink). */
+  void ConnectSink(Ptr<Application> sink) {
+    sink->TraceConnectWithoutContext(
+        "Rx", MakeCallback(&TrajectoryStats::Received, this));
+  }
+
+  /* SINR reports of the UE and the eNB's downlink scheduling decisions. */
+  void ConnectLte(Ptr<NetDevice> ueDevice, Ptr<NetDevice> enbDevice) {
+    ueDevice->GetObject<LteUeNetDevice>()
+        ->GetPhy()
+        ->TraceConnectWithoutContext(
+            "ReportCurrentCellRsrpSinr",
+            MakeCallback(&TrajectoryStats::SinrReported, this));
+    enbDevice->GetObject<LteEnbNetDevice>()
+        ->GetMac()
+        ->TraceConnectWithoutContext(
+            "DlScheduling", MakeCallback(&TrajectoryStats::Scheduled, this));
+  }
+
+  /*
+   * One line per bin in travel order: mean position (x, y, z), mean
+   * distance to the eNB [m], throughput [bit/s], mean SINR [dB] and mean
+   * MCS of the first transport block.
+   */
+  void Write(const std::string &path) const {
+    std::ofstream out(path);
+    out << "% x\ty\tz\tdistance\tthroughput\tsinr\tmcs\n";
+    for (std::map<int64_t, Bin>::const_iterator i = m_bins.begin();
+         i != m_bins.end(); i++) {
+      const Bin &b = i->second;
+      double seconds = (b.last - b.first).GetSeconds();
+      out << b.x / b.events << "\t" << b.y / b.events << "\t"
+          << b.z / b.events << "\t" << b.distance / b.events << "\t"
+          << (seconds > 0 ? b.bytes * 8 / seconds : 0.0) << "\t"
+          << (b.sinrs ? 10 * std::log10(b.sinr / b.sinrs) : NAN) << "\t"
+          << (b.blocks ? double(b.mcs) / b.blocks : NAN) << "\n";
+    }
+  }
+
+private:
+  struct Bin {
+    Bin()
+        : events(0), x(0), y(0), z(0), distance(0), bytes(0), sinr(0),
+          sinrs(0), mcs(0), blocks(0) {}
+
+    Time first, last;
+    uint64_t events;
+    double x, y, z, distance; // Sums over the events
+    uint64_t bytes;
+    double sinr; // Linear
+    uint64_t sinrs;
+    uint64_t mcs;
+    uint64_t blocks;
+  };
+
+  /* The bin of the current position, or 0 before `start`. */
+  Bin *Current() {
+    Time now = Simulator::Now();
+    if (now < m_start) {
+      return 0;
+    }
+    Vector p = m_ue->GetPosition();
+    if (m_bins.empty()) {
+      m_origin = p;
+    }
+    Bin &b = m_bins[int64_t(
+        std::floor(CalculateDistance(p, m_origin) / m_binWidth))];
+    if (b.events++ == 0) {
+      b.first = now;
+    }
+    b.last = now;
+    b.x += p.x;
+    b.y += p.y;
+    b.z += p.z;
+    b.distance += CalculateDistance(p, m_enb->GetPosition());
+    return &b;
+  }
+
+  void Received(Ptr<const Packet> packet, const Address &from) {
+    Bin *b = Current();
+    if (b) {
+      b->bytes += packet->GetSize();
+    }
+  }
+
+  void SinrReported(uint16_t cellId, uint16_t rnti, double rsrp, double sinr,
+                    uint8_t componentCarrierId) {
+    Bin *b = Current();
+    if (b) {
+      b->sinr += sinr;
+      b->sinrs++;
+    }
+  }
+
+  // The eNB serves only this UE, so every transport block is for it
+  void Scheduled(DlSchedulingCallbackInfo info) {
+    Bin *b = Current();
+    if (b) {
+      b->mcs += info.mcsTb1;
+      b->blocks++;
+    }
+  }
+
+  Ptr<MobilityModel> m_ue;
+  Ptr<MobilityModel> m_enb;
+  double m_binWidth;
+  Time m_start;
+  Vector m_origin;
+  std::map<int64_t, Bin> m_bins;
+};
+
+} // namespace ns3
+
+#endif /* TRAJECTORY_STATS_H */
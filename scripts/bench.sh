@@ -0,0 +1,16 @@
+#!/bin/sh
+# Run this script from NS-3 project root directory (in Docker).
+#
+# Builds once and runs the scenario benchmark suite (scratch/bench.cc) against
+# bench/baseline.tsv. Pass --update to record a new baseline, --filter=lab3-*
+# to run a subset; any other bench option is passed through as well. Exits
+# with status 3 when a metric regressed beyond the threshold.
+
+set -e
+set -v
+
+./waf build
+status=0
+build/scratch/bench --output=results/bench/report.md "$@" || status=$?
+cat results/bench/report.md
+exit $status
@@ -0,0 +1,29 @@
+#!/bin/sh
+# Run this script from NS-3 project root directory (in Docker).
+#
+# Replaces the seed 15 vs. seed 1337 comparison of measurements/scenario1.md
+# with confidence intervals: every scenario 1 configuration is replicated on
+# independent RNG runs of seed 15 until the 95% CI of goodput and total
+# throughput is within HALF_WIDTH (default 2%) of the mean, or 100 runs have
+# been simulated. One markdown table per configuration ends up in
+# results/lab2/replicate/.
+
+set -e
+set -v
+
+./waf build
+mkdir -p results/lab2/replicate
+
+for scenario in 1p1 1p2; do
+	for rate in DsssRate1Mbps DsssRate5_5Mbps DsssRate11Mbps; do
+		build/scratch/replicate \
+			--program=build/scratch/lab2-scenario$scenario \
+			--args="--seed=15 --rate=$rate --pcap=0" \
+			--metrics="total,*.goodput" \
+			--halfWidth=${HALF_WIDTH:-0.02} \
+			--recordDir=results/lab2/replicate/$scenario-$rate \
+			--output=results/lab2/replicate/$scenario-$rate.md \
+			--jobs=${JOBS:-0} ||
+			echo "$scenario $rate did not settle within the run limit"
+	done
+done
@@ -1,3 +1,4 @@
 set -v
-./waf --run "LAB3adhoc --nWifi=3 --packetSize=300"
-./waf --run "LAB3adhoc --nWifi=3 --packetSize=1200"
+# Under OLSR the TCP sources start once both ends have a route.
+./waf --run "LAB3adhoc --nWifi=3 --packetSize=300 --transport=tcp"
+./waf --run "LAB3adhoc --nWifi=3 --packetSize=1200 --transport=tcp"
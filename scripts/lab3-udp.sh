@@ -1,13 +1,33 @@
+#!/bin/sh
+# Run this script from NS-3 project root directory (in Docker).
+#
+# Builds once and then runs the whole nWifi x packetSize grid of LAB3adhoc in
+# parallel through the sweep executor (one worker per CPU by default, override
+# with JOBS). Per-run logs end up in results/lab3/logs, the exit status of
+# every configuration in results/lab3/manifest.csv and the throughput record
+# of every run in results/lab3/records.txt. Set PCAP=0 to skip pcap capture
+# and ROUTING=static to replace OLSR by routes computed at setup.
+#
+# Configurations already simulated with the same binary and arguments are
+# restored from the result store ($CACHE, results/sweep-cache.db by default)
+# instead of being run again; set CACHE= to always simulate.
+
+set -e
 set -v
-./waf --run "LAB3adhoc --nWifi=6 --packetSize=300"
-./waf --run "LAB3adhoc --nWifi=6 --packetSize=700"
-./waf --run "LAB3adhoc --nWifi=6 --packetSize=1200"
-./waf --run "LAB3adhoc --nWifi=5 --packetSize=300"
-./waf --run "LAB3adhoc --nWifi=5 --packetSize=700"
-./waf --run "LAB3adhoc --nWifi=5 --packetSize=1200"
-./waf --run "LAB3adhoc --nWifi=4 --packetSize=300"
-./waf --run "LAB3adhoc --nWifi=4 --packetSize=700"
-./waf --run "LAB3adhoc --nWifi=4 --packetSize=1200"
-./waf --run "LAB3adhoc --nWifi=3 --packetSize=300"
-./waf --run "LAB3adhoc --nWifi=3 --packetSize=700"
-./waf --run "LAB3adhoc --nWifi=3 --packetSize=1200"
+
+./waf build
+mkdir -p results/lab3/logs
+# Each run writes its record next to its pcaps so the cache keeps both.
+rm -f results/nSta-*-pktSize-*-node-record.txt
+
+build/scratch/sweep \
+	--program=build/scratch/LAB3adhoc \
+	--grid="nWifi=6,5,4,3;packetSize=300,700,1200" \
+	--args="--pcap=${PCAP:-1} --routing=${ROUTING:-olsr} --output=results/nSta-{nWifi}-pktSize-{packetSize}-node-record.txt" \
+	--output="results/nSta-{nWifi}-pktSize-{packetSize}-node" \
+	--logDir=results/lab3/logs \
+	--manifest=results/lab3/manifest.csv \
+	--cache="${CACHE-results/sweep-cache.db}" \
+	--jobs=${JOBS:-0}
+
+cat results/nSta-*-pktSize-*-node-record.txt > results/lab3/records.txt
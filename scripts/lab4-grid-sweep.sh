@@ -0,0 +1,25 @@
+#!/bin/sh
+# Run this script from NS-3 project root directory (in Docker).
+#
+# Throughput coverage map of the lab4 eNB for one antenna type (default
+# ParabolicAntennaModel, or $1) over x, y in [-5000, 5000] m at UE height 1 m,
+# 250 m apart. Only regions where the throughput changes by more than
+# THRESHOLD Mbps (default 1) between coarse points are simulated at full
+# resolution. The map ends up in results/lab4-grid/<antenna>.csv and .bin.
+
+set -e
+set -v
+
+ANTENNA=${1:-ParabolicAntennaModel}
+
+./waf build
+mkdir -p results/lab4-grid
+
+build/scratch/lab4-grid-sweep \
+	--args="--simTime=${SIM_TIME:-5} --antennaType=$ANTENNA" \
+	--x=-5000:5000 --y=-5000:5000 --z=1 --step=250 \
+	--threshold=${THRESHOLD:-1} \
+	--workDir=results/lab4-grid/$ANTENNA \
+	--csv=results/lab4-grid/$ANTENNA.csv \
+	--binary=results/lab4-grid/$ANTENNA.bin \
+	--jobs=${JOBS:-0}
@@ -56,3 +56,28 @@ plot "< head -n 101 results/lab4/isotropic/DlRlcStats.txt | tail -n 100" \
         title "RLC throughput (Parabolic)" \
         ls 3 \
         with linespoints
+
+# After a run with TRAJECTORY set in lab4-run-simulations.sh, add
+# -e trajectory=1 for the throughput along the UE's path from one run.
+if (exists("trajectory")) {
+set title "Throughput along the UE path for different antenna types, with rate: ".rate." Mbps"
+set output "trajectory-throughput-plot_".suffix.".png"
+set xrange [*:*]
+set xlabel "UE x position (m)"
+set ylabel "Throughput (bps)"
+plot "results/lab4/isotropic/Trajectory.txt" \
+        using ($1):($5) \
+        title "Throughput (Isotropic)" \
+        ls 1 \
+        with linespoints,\
+     "results/lab4/cosine/Trajectory.txt" \
+        using ($1):($5) \
+        title "Throughput (Cosine)" \
+        ls 2 \
+        with linespoints,\
+     "results/lab4/parabolic/Trajectory.txt" \
+        using ($1):($5) \
+        title "Throughput (Parabolic)" \
+        ls 3 \
+        with linespoints
+}
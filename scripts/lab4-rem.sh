@@ -0,0 +1,18 @@
+#!/bin/sh
+# Run this script from NS-3 project root directory (in Docker).
+#
+# SINR maps of the lab4 cell for the isotropic, parabolic and cosine eNB
+# antennas over x, y in [-5000, 5000] m every STEP metres (default 5, about
+# four million points per antenna), computed on all cores. The grid ends up in
+# results/lab4-rem/rem.bin; see scratch/lab4-rem.cc for its layout. Pass
+# --enbHeight=..., --z=... or --ns3::ParabolicAntennaModel::Beamwidth=... etc.
+# as arguments to change the cell.
+
+set -e
+set -v
+
+./waf build
+build/scratch/lab4-rem \
+	--x=-5000:5000 --y=-5000:5000 --step=${STEP:-5} \
+	--output=results/lab4-rem/rem.bin \
+	--threads=${THREADS:-0} "$@"
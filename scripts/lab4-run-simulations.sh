@@ -7,24 +7,49 @@ X=$1
 Y=$2
 Z=$3
 APP_DATA_RATE=$4
+# TRAJECTORY=x:y:z moves the UE from ($1, $2, $3) to there during the run and
+# adds Trajectory.txt (throughput, SINR and MCS per distance bin).
+MOVE=${TRAJECTORY:+--trajectory=$TRAJECTORY}
 
 echo "Running with UE vectors: ($1, $2, $3) and app. data rate: $4 Mbps"
 
 set -e
 set -v
 
-./waf --run "lab4-scenario \
-	-x=$1 -y=$2 -z=$3 \
-	--appDataRate=$4 \
-	--outputPath=results/lab4/isotropic \
-	--antennaType=IsotropicAntennaModel"
-./waf --run "lab4-scenario \
-	-x=$1 -y=$2 -z=$3 \
-	--appDataRate=$4 \
-	--outputPath=results/lab4/parabolic \
-	--antennaType=ParabolicAntennaModel"
-./waf --run "lab4-scenario \
-	-x=$1 -y=$2 -z=$3 \
-	--appDataRate=$4 \
-	--outputPath=results/lab4/cosine \
-	--antennaType=CosineAntennaModel"
+# Build once, then simulate the three antenna variants in a single run
+# (--compareAntennas: one eNB/UE pair per antenna on its own carrier behind a
+# shared EPC), which splits the statistics into results/lab4/<antenna>. Set
+# SEPARATE=1 to run them as three processes side by side through the sweep
+# executor instead. Either way, runs already simulated with the same build and
+# arguments are restored from the result store ($CACHE, set CACHE= to always
+# simulate).
+./waf build
+mkdir -p results/lab4/logs \
+	results/lab4/isotropic results/lab4/parabolic results/lab4/cosine \
+	results/lab4/compare
+
+if [ -z "$SEPARATE" ]; then
+	build/scratch/sweep \
+		--program=build/scratch/lab4-scenario \
+		--grid="compareAntennas=1" \
+		--args="-x=$X -y=$Y -z=$Z --appDataRate=$APP_DATA_RATE $MOVE --outputPath=results/lab4/compare" \
+		--output="results/lab4/compare" \
+		--logDir=results/lab4/logs \
+		--manifest=results/lab4/manifest.csv \
+		--cache="${CACHE-results/sweep-cache.db}" \
+		--jobs=1
+	for ANTENNA in isotropic parabolic cosine; do
+		cp results/lab4/compare/$ANTENNA/* results/lab4/$ANTENNA/
+	done
+	exit 0
+fi
+
+build/scratch/sweep \
+	--program=build/scratch/lab4-scenario \
+	--grid="antennaType=IsotropicAntennaModel@isotropic,ParabolicAntennaModel@parabolic,CosineAntennaModel@cosine" \
+	--args="-x=$X -y=$Y -z=$Z --appDataRate=$APP_DATA_RATE $MOVE --outputPath=results/lab4/{antennaType.label}" \
+	--output="results/lab4/{antennaType.label}" \
+	--logDir=results/lab4/logs \
+	--manifest=results/lab4/manifest.csv \
+	--cache="${CACHE-results/sweep-cache.db}" \
+	--jobs=3